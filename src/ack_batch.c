@@ -0,0 +1,126 @@
+
+#include "ack_batch.h"
+
+#include <proton/delivery.h>
+#include <proton/disposition.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int ack_batch_init(ack_batch_t *acks, const int size, const int window_ms) {
+    if (size <= 0) {
+        return -1;
+    }
+    acks->pending = (pn_delivery_t**)calloc(size, sizeof(pn_delivery_t*));
+    acks->keys = (uint64_t*)calloc(size, sizeof(uint64_t));
+    if (!acks->pending || !acks->keys) {
+        free(acks->pending);
+        free(acks->keys);
+        return -1;
+    }
+    acks->count = 0;
+    acks->counted = 0;
+    acks->size = size;
+    acks->window_ns = (uint64_t)window_ms * 1000000;
+    acks->oldest_ns = 0;
+    acks->received = 0;
+    acks->flushes = 0;
+    acks->released = 0;
+    acks->commit = NULL;
+    acks->commit_context = NULL;
+    acks->accepted = NULL;
+    acks->accepted_context = NULL;
+    acks->release = NULL;
+    acks->release_context = NULL;
+    return 0;
+}
+
+void ack_batch_free(ack_batch_t *acks) {
+    free(acks->pending);
+    free(acks->keys);
+    acks->pending = NULL;
+    acks->keys = NULL;
+    acks->count = 0;
+}
+
+void ack_batch_set_commit(ack_batch_t *acks, int (*commit)(void *context), void *context) {
+    acks->commit = commit;
+    acks->commit_context = context;
+}
+
+void ack_batch_set_accepted(ack_batch_t *acks, void (*accepted)(void *context, const uint64_t key), void *context) {
+    acks->accepted = accepted;
+    acks->accepted_context = context;
+}
+
+void ack_batch_set_released(ack_batch_t *acks, void (*released)(void *context, const int count), void *context) {
+    acks->release = released;
+    acks->release_context = context;
+}
+
+void ack_batch_add(ack_batch_t *acks, pn_delivery_t *d, const uint64_t key, const bool counted, const uint64_t now_ns) {
+    if (acks->count == 0) {
+        acks->oldest_ns = now_ns;
+    }
+    acks->keys[acks->count] = key;
+    acks->pending[acks->count++] = d;
+    if (counted) {
+        acks->counted++;
+    }
+    acks->received++;
+    if (acks->count == acks->size) {
+        ack_batch_flush(acks);
+    }
+}
+
+void ack_batch_flush(ack_batch_t *acks) {
+    if (acks->count == 0) {
+        return;
+    }
+    /* only accept what the commit made durable, the peer redelivers the rest */
+    uint64_t outcome = PN_ACCEPTED;
+    if (acks->commit && acks->commit(acks->commit_context) != 0) {
+        outcome = PN_RELEASED;
+        acks->released += acks->count;
+    }
+    /* in arrival order, so proton sees consecutive delivery ids */
+    for (int i = 0; i < acks->count; i++) {
+        pn_delivery_update(acks->pending[i], outcome);
+        pn_delivery_settle(acks->pending[i]);  /* settle and free the delivery */
+        if (outcome == PN_ACCEPTED && acks->accepted && acks->keys[i] != 0) {
+            acks->accepted(acks->accepted_context, acks->keys[i]);
+        }
+    }
+    if (outcome == PN_RELEASED && acks->release) {
+        acks->release(acks->release_context, acks->counted);
+    }
+    acks->count = 0;
+    acks->counted = 0;
+    acks->flushes++;
+}
+
+void ack_batch_flush_due(ack_batch_t *acks, const uint64_t now_ns) {
+    if (acks->count > 0 && now_ns - acks->oldest_ns >= acks->window_ns) {
+        ack_batch_flush(acks);
+    }
+}
+
+void ack_batch_discard(ack_batch_t *acks) {
+    acks->count = 0;
+    acks->counted = 0;
+}
+
+void ack_batch_merge(ack_batch_t *dest, const ack_batch_t *src) {
+    dest->received += src->received;
+    dest->flushes += src->flushes;
+    dest->released += src->released;
+}
+
+void ack_batch_print(const ack_batch_t *acks, FILE *out) {
+    fprintf(out, "acks: %llu messages accepted in %llu batches\n",
+            (unsigned long long)(acks->received - acks->released), (unsigned long long)acks->flushes);
+    if (acks->released > 0) {
+        fprintf(out, "acks: %llu messages released, their journal commit failed\n", (unsigned long long)acks->released);
+    }
+}
@@ -0,0 +1,132 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifndef ACK_BATCH_H
+#define ACK_BATCH_H 1
+
+
+#include <proton/delivery.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/*
+ * Accepted deliveries held to be settled together.
+ *
+ * Settling a run of consecutive deliveries in one go lets proton send a
+ * single disposition for the whole range instead of one per message.
+ * The batch is flushed when it holds 'size' deliveries or when the oldest
+ * has been held for the window, whichever comes first. With a size of 1
+ * each delivery is settled as soon as it is added.
+ *
+ * An optional commit callback runs before each flush, so a whole batch can
+ * be made durable with one write before any of it is accepted. If the
+ * commit fails the batch is released for redelivery instead.
+ *
+ * An optional accepted callback runs with the key of each delivery once
+ * it is accepted, not for released or discarded deliveries. An optional
+ * released callback runs with the number of deliveries a failed commit
+ * released, so callers can take them back out of their message count.
+ * Only deliveries added as counted are included, eg. not duplicates.
+ * */
+typedef struct ack_batch_t {
+  pn_delivery_t **pending;
+  uint64_t *keys;        /* caller key of each pending delivery, 0 for none */
+  int count;
+  int counted;           /* pending deliveries the caller counts as messages */
+  int size;
+  uint64_t window_ns;
+  uint64_t oldest_ns;    /* when the first pending delivery was added */
+  uint64_t received;     /* deliveries accepted */
+  uint64_t flushes;      /* settlement batches, a batch spanning links or id gaps takes several disposition ranges */
+  uint64_t released;     /* deliveries released because their commit failed */
+  int (*commit)(void *context);  /* returns 0 once the batch is durable, NULL for none */
+  void *commit_context;
+  void (*accepted)(void *context, const uint64_t key);  /* NULL for none */
+  void *accepted_context;
+  void (*release)(void *context, const int count);  /* NULL for none */
+  void *release_context;
+} ack_batch_t;
+
+/*
+ * Allocates room for 'size' pending deliveries.
+ *
+ * @returns: 0 on success, -1 if size is not positive or allocation failed
+ * */
+int ack_batch_init(ack_batch_t *acks, const int size, const int window_ms);
+
+void ack_batch_free(ack_batch_t *acks);
+
+/*
+ * Sets the callback run before each flush, with its context argument.
+ * */
+void ack_batch_set_commit(ack_batch_t *acks, int (*commit)(void *context), void *context);
+
+/*
+ * Sets the callback run for each key once its delivery is accepted, with its context argument.
+ * */
+void ack_batch_set_accepted(ack_batch_t *acks, void (*accepted)(void *context, const uint64_t key), void *context);
+
+/*
+ * Sets the callback run with the number of deliveries released when a commit fails, with its context argument.
+ * */
+void ack_batch_set_released(ack_batch_t *acks, void (*released)(void *context, const int count), void *context);
+
+/*
+ * Holds an accepted delivery, flushing the batch if it is full.
+ *
+ * @param[in]: key, passed to the accepted callback once the delivery is accepted, 0 for none
+ * @param[in]: counted, false for a delivery the caller does not count, eg. a duplicate
+ * */
+void ack_batch_add(ack_batch_t *acks, pn_delivery_t *d, const uint64_t key, const bool counted, const uint64_t now_ns);
+
+/*
+ * Accepts and settles all pending deliveries, or releases them if the
+ * commit callback fails.
+ * */
+void ack_batch_flush(ack_batch_t *acks);
+
+/*
+ * Flushes if the oldest pending delivery has been held for the window.
+ * */
+void ack_batch_flush_due(ack_batch_t *acks, const uint64_t now_ns);
+
+/*
+ * Forgets the pending deliveries without settling them, for when their
+ * connection has closed.
+ * */
+void ack_batch_discard(ack_batch_t *acks);
+
+/*
+ * Adds the counters of src to dest.
+ * */
+void ack_batch_merge(ack_batch_t *dest, const ack_batch_t *src);
+
+/*
+ * Prints the messages accepted and the batches they were settled in. Proton
+ * does not expose delivery ids, so the disposition frames sent are not
+ * counted, there is at least one per batch.
+ * */
+void ack_batch_print(const ack_batch_t *acks, FILE *out);
+
+#endif /* ack_batch.h */
@@ -0,0 +1,96 @@
+
+#include "addr_cache.h"
+#include "util.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ADDR_CACHE_INITIAL_BUCKETS 64
+
+int addr_cache_init(addr_cache_t *cache, const size_t max_bytes) {
+    if (lru_table_init(&cache->table, ADDR_CACHE_INITIAL_BUCKETS) != 0) {
+        return -1;
+    }
+    cache->bytes = 0;
+    cache->max_bytes = max_bytes;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    return 0;
+}
+
+void addr_cache_free(addr_cache_t *cache) {
+    lru_node_t *node = cache->table.newest;
+    while (node) {
+        lru_node_t *older = node->older;
+        free(node);
+        node = older;
+    }
+    lru_table_free(&cache->table);
+    cache->bytes = 0;
+}
+
+static void evict_oldest(addr_cache_t *cache) {
+    addr_entry_t *entry = (addr_entry_t*)cache->table.oldest;
+    lru_table_remove(&cache->table, &entry->node);
+    cache->bytes -= entry->size;
+    cache->evictions++;
+    free(entry);
+}
+
+const char *addr_cache_get(addr_cache_t *cache, const char *address, const size_t address_len,
+                           const char *address_prefix, const size_t address_prefix_len) {
+    const char *prefix = address_prefix ? address_prefix : "";
+    const size_t key_prefix_len = address_prefix ? address_prefix_len : 0;
+    const uint64_t hash = hash_bytes(address, address_len) ^ (hash_bytes(prefix, key_prefix_len) * 31);
+    for (lru_node_t *node = lru_table_chain(&cache->table, hash); node; node = node->next) {
+        addr_entry_t *entry = (addr_entry_t*)node;
+        if (node->hash == hash && entry->base_len == address_len && entry->prefix_len == key_prefix_len
+            && memcmp(entry->key, address, address_len) == 0
+            && memcmp(entry->key + address_len, prefix, key_prefix_len) == 0) {
+            cache->hits++;
+            lru_table_touch(&cache->table, node);
+            return entry->address;
+        }
+    }
+    cache->misses++;
+    /* the key bytes, then room for the prefixed address and its nul */
+    const size_t address_size = address_len + key_prefix_len + 1;
+    const size_t size = sizeof(addr_entry_t) + address_len + key_prefix_len + address_size;
+    while (cache->table.count > 0 && cache->bytes + size > cache->max_bytes) {
+        evict_oldest(cache);
+    }
+    addr_entry_t *entry = (addr_entry_t*)malloc(size);
+    if (!entry) {
+        return NULL;
+    }
+    memcpy(entry->key, address, address_len);
+    memcpy(entry->key + address_len, prefix, key_prefix_len);
+    entry->address = entry->key + address_len + key_prefix_len;
+    /* as amqp_destination_address, the prefix is only added if the address does not start with it */
+    size_t offset = 0;
+    if (!(address_len > key_prefix_len && memcmp(address, prefix, key_prefix_len) == 0)) {
+        memcpy(entry->address, prefix, key_prefix_len);
+        offset = key_prefix_len;
+    }
+    memcpy(entry->address + offset, address, address_len);
+    entry->address[offset + address_len] = '\0';
+    entry->base_len = address_len;
+    entry->prefix_len = key_prefix_len;
+    entry->size = size;
+    /* double the buckets once the chains average more than one entry */
+    if (cache->table.count >= cache->table.mask + 1) {
+        lru_table_grow(&cache->table);
+    }
+    lru_table_insert(&cache->table, &entry->node, hash);
+    cache->bytes += size;
+    return entry->address;
+}
+
+void addr_cache_print(const addr_cache_t *cache, FILE *out) {
+    fprintf(out, "address cache: %llu hits, %llu misses, %llu evictions, %zu addresses in %zu of %zu bytes\n",
+            (unsigned long long)cache->hits, (unsigned long long)cache->misses,
+            (unsigned long long)cache->evictions, cache->table.count, cache->bytes, cache->max_bytes);
+}
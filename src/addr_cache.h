@@ -0,0 +1,86 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+
+#ifndef ADDR_CACHE_H
+#define ADDR_CACHE_H 1
+
+
+#include "lru_table.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/*
+ * Interned destination addresses, keyed by the base address and the
+ * destination type prefix.
+ *
+ * The first lookup of a key formats the address the way
+ * amqp_destination_address does and keeps it, later lookups return the
+ * same string without formatting. Entries are chained in a hash table and on
+ * a least recently used list; when the entries outgrow the memory cap
+ * the least recently used are evicted.
+ * */
+typedef struct addr_entry_t {
+  lru_node_t node;               /* first, the hash chain and LRU list */
+  size_t base_len;
+  size_t prefix_len;
+  size_t size;                   /* bytes of the entry allocation */
+  char *address;                 /* the prefixed address, nul terminated */
+  char key[];                    /* base and prefix, then the address */
+} addr_entry_t;
+
+typedef struct addr_cache_t {
+  lru_table_t table;
+  size_t bytes;                  /* bytes of the entries */
+  size_t max_bytes;              /* cap on the entries' bytes */
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+} addr_cache_t;
+
+/*
+ * @param[in]: max_bytes, cap on the memory of the cached addresses
+ *
+ * @returns: 0 on success, -1 if allocation failed
+ * */
+int addr_cache_init(addr_cache_t *cache, const size_t max_bytes);
+
+void addr_cache_free(addr_cache_t *cache);
+
+/*
+ * Returns the address prefixed as amqp_destination_address would format it.
+ * The string is owned by the cache and stays valid until its entry is
+ * evicted, ie. at least until the next lookup of another key.
+ *
+ * @param[in]: address, the base address, eg. 'my_topic'
+ * @param[in]: address_prefix, the destination type prefix, eg. 'topic://', may be NULL
+ *
+ * @returns: the prefixed address, NULL if allocation failed
+ * */
+const char *addr_cache_get(addr_cache_t *cache, const char *address, const size_t address_len,
+                           const char *address_prefix, const size_t address_prefix_len);
+
+void addr_cache_print(const addr_cache_t *cache, FILE *out);
+
+#endif /* addr_cache.h */
@@ -0,0 +1,174 @@
+
+#include "conn_props.h"
+#include "util.h"
+
+#include <proton/codec.h>
+#include <proton/connection.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t key_hash(const bool capability, const char *key, const size_t key_len) {
+    return hash_bytes(key, key_len) ^ (capability ? 1 : 0);
+}
+
+/* Slot holding the key, or the empty slot where it would go */
+static size_t find_slot(const conn_props_t *props, const bool capability,
+                        const char *key, const size_t key_len, const uint64_t hash) {
+    size_t i = hash & props->mask;
+    for (; props->slots[i].key.start; i = (i + 1) & props->mask) {
+        const conn_prop_t *prop = &props->slots[i];
+        if (prop->hash == hash && prop->capability == capability && prop->key.size == key_len
+            && memcmp(prop->key.start, key, key_len) == 0) {
+            break;
+        }
+    }
+    return i;
+}
+
+static pn_bytes_t copy_string(conn_props_t *props, const pn_bytes_t bytes) {
+    char *start = props->strings + props->used;
+    memcpy(start, bytes.start, bytes.size);
+    props->used += bytes.size;
+    return pn_bytes(bytes.size, start);
+}
+
+/*
+ * Counts an entry and its string bytes while sizing the index, or adds it
+ * once the table is allocated. The first of repeated keys is kept.
+ */
+static void add_entry(conn_props_t *props, const bool capability, const pn_bytes_t key,
+                      const pn_type_t type, const pn_bytes_t value, size_t *bytes) {
+    if (!props->slots) {
+        props->count++;
+        *bytes += key.size + value.size;
+        return;
+    }
+    const uint64_t hash = key_hash(capability, key.start, key.size);
+    conn_prop_t *prop = &props->slots[find_slot(props, capability, key.start, key.size, hash)];
+    if (prop->key.start) {
+        return;
+    }
+    prop->key = copy_string(props, key);
+    prop->value = copy_string(props, value);
+    prop->type = type;
+    prop->capability = capability;
+    prop->hash = hash;
+    props->count++;
+}
+
+/* The contents of the current string or symbol, NULL start for other types */
+static pn_bytes_t get_string(pn_data_t *data) {
+    switch (pn_data_type(data)) {
+    case PN_STRING: return pn_data_get_string(data);
+    case PN_SYMBOL: return pn_data_get_symbol(data);
+    default: return pn_bytes(0, NULL);
+    }
+}
+
+/* Walks the properties map and the capabilities, a symbol array or a single symbol */
+static void index_data(conn_props_t *props, pn_data_t *properties, pn_data_t *capabilities, size_t *bytes) {
+    if (properties) {
+        pn_handle_t start = pn_data_point(properties);
+        pn_data_rewind(properties);
+        if (pn_data_next(properties) && pn_data_type(properties) == PN_MAP) {
+            const size_t count = pn_data_get_map(properties);
+            pn_data_enter(properties);
+            for (size_t i = 0; i + 1 < count; i += 2) {
+                if (!pn_data_next(properties)) break;
+                pn_bytes_t key = get_string(properties);
+                if (!pn_data_next(properties)) break;
+                pn_bytes_t value = get_string(properties);
+                if (key.start) {
+                    add_entry(props, false, key, pn_data_type(properties),
+                              value.start ? value : pn_bytes(0, ""), bytes);
+                }
+            }
+        }
+        pn_data_restore(properties, start);
+    }
+    if (capabilities) {
+        pn_handle_t start = pn_data_point(capabilities);
+        pn_data_rewind(capabilities);
+        if (pn_data_next(capabilities)) {
+            if (pn_data_type(capabilities) == PN_ARRAY) {
+                const size_t count = pn_data_get_array(capabilities);
+                pn_data_enter(capabilities);
+                for (size_t i = 0; i < count && pn_data_next(capabilities); i++) {
+                    pn_bytes_t capability = get_string(capabilities);
+                    if (capability.start) {
+                        add_entry(props, true, capability, PN_SYMBOL, pn_bytes(0, ""), bytes);
+                    }
+                }
+            } else {
+                pn_bytes_t capability = get_string(capabilities);
+                if (capability.start) {
+                    add_entry(props, true, capability, PN_SYMBOL, pn_bytes(0, ""), bytes);
+                }
+            }
+        }
+        pn_data_restore(capabilities, start);
+    }
+}
+
+int conn_props_load(conn_props_t *props, pn_connection_t *connection) {
+    conn_props_free(props);
+    pn_data_t *properties = pn_connection_remote_properties(connection);
+    pn_data_t *capabilities = pn_connection_remote_offered_capabilities(connection);
+    /* the first walk sizes the table and the string block, the second fills them */
+    size_t bytes = 0;
+    index_data(props, properties, capabilities, &bytes);
+    size_t size = 2;
+    while (size < 2 * props->count) {
+        size *= 2;
+    }
+    props->slots = (conn_prop_t*)calloc(size, sizeof(conn_prop_t));
+    props->strings = (char*)malloc(bytes > 0 ? bytes : 1);
+    if (!props->slots || !props->strings) {
+        conn_props_free(props);
+        return -1;
+    }
+    props->mask = size - 1;
+    props->count = 0;
+    props->used = 0;
+    index_data(props, properties, capabilities, &bytes);
+    return 0;
+}
+
+int conn_props_get_string(const conn_props_t *props, const char *key, char *value, const size_t value_size) {
+    if (!props->slots) {
+        return -1;
+    }
+    const size_t key_len = strlen(key);
+    const conn_prop_t *prop = &props->slots[find_slot(props, false, key, key_len, key_hash(false, key, key_len))];
+    if (!prop->key.start) {
+        return -1;
+    }
+    if ((prop->type != PN_STRING && prop->type != PN_SYMBOL) || prop->value.size == 0
+        || prop->value.size >= value_size) {
+        return 0;
+    }
+    memcpy(value, prop->value.start, prop->value.size);
+    value[prop->value.size] = '\0';
+    return (int)prop->value.size;
+}
+
+bool conn_props_has_capability(const conn_props_t *props, const char *capability) {
+    if (!props->slots) {
+        return false;
+    }
+    const size_t len = strlen(capability);
+    return props->slots[find_slot(props, true, capability, len, key_hash(true, capability, len))].key.start != NULL;
+}
+
+void conn_props_free(conn_props_t *props) {
+    free(props->slots);
+    free(props->strings);
+    props->slots = NULL;
+    props->strings = NULL;
+    props->mask = 0;
+    props->count = 0;
+    props->used = 0;
+}
@@ -0,0 +1,87 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+
+#ifndef CONN_PROPS_H
+#define CONN_PROPS_H 1
+
+
+#include <proton/connection.h>
+#include <proton/codec.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/*
+ * An index of the properties and offered capabilities a broker sent in
+ * its open frame.
+ *
+ * conn_props_load decodes them once per open into a hash table of the
+ * string and symbol keys. Keys and string values are copied into one
+ * block, so the index stays valid after the connection is freed and
+ * lookups neither walk the map nor print anything.
+ * */
+typedef struct conn_prop_t {
+  pn_bytes_t key;        /* key.start is NULL for an empty slot */
+  pn_bytes_t value;      /* string or symbol value, empty for other types */
+  pn_type_t type;        /* the value's type */
+  bool capability;       /* an offered capability, not a property */
+  uint64_t hash;
+} conn_prop_t;
+
+typedef struct conn_props_t {
+  conn_prop_t *slots;    /* open addressing table, at most half full */
+  size_t mask;           /* table size - 1 */
+  size_t count;          /* properties and capabilities indexed */
+  char *strings;         /* keys and values copied from the open frame */
+  size_t used;           /* bytes of strings filled */
+} conn_props_t;
+
+/*
+ * Indexes the remote properties and offered capabilities of an opened
+ * connection, replacing anything indexed before.
+ *
+ * @returns: 0 on success, -1 if allocation failed
+ * */
+int conn_props_load(conn_props_t *props, pn_connection_t *connection);
+
+/*
+ * Copies a string or symbol property value, nul terminated.
+ *
+ * @param[in]: key, the property key
+ * @param[out]: value, the buffer the value is copied to
+ * @param[in]: value_size, the buffer size
+ *
+ * @returns: -1 if the key is absent, 0 if the value is not a string or
+ *           symbol, is empty or does not fit, else the value length
+ * */
+int conn_props_get_string(const conn_props_t *props, const char *key, char *value, const size_t value_size);
+
+/*
+ * @returns: true if the broker offered the capability, eg. ANONYMOUS-RELAY
+ * */
+bool conn_props_has_capability(const conn_props_t *props, const char *capability);
+
+void conn_props_free(conn_props_t *props);
+
+#endif /* conn_props.h */
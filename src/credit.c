@@ -0,0 +1,66 @@
+
+#include "credit.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+void credit_init(credit_t *credit, const int max_window, const size_t byte_budget, const int latency_ms) {
+    credit->max_window = max_window;
+    credit->window = max_window < CREDIT_INITIAL_WINDOW ? max_window : CREDIT_INITIAL_WINDOW;
+    credit->byte_budget = byte_budget;
+    credit->latency_ns = (uint64_t)latency_ms * 1000000;
+    credit->rate = 0;
+    credit->avg_size = 0;
+    credit->interval_start_ns = 0;
+    credit->interval_count = 0;
+}
+
+/* Sizes the window for the measured rate and message size */
+static void adapt(credit_t *credit) {
+    double target = credit->rate * (double)credit->latency_ns / 1e9;
+    double window = credit->window;
+    /* move towards the target by at most 4x up or half down per interval */
+    if (target > window * 4) {
+        window = window * 4;
+    } else {
+        window = target > window / 2 ? target : window / 2;
+    }
+    if (window > credit->max_window) {
+        window = credit->max_window;
+    }
+    if (credit->avg_size > 0 && window * credit->avg_size > credit->byte_budget) {
+        window = credit->byte_budget / credit->avg_size;
+    }
+    if (window < CREDIT_MIN_WINDOW) {
+        window = CREDIT_MIN_WINDOW < credit->max_window ? CREDIT_MIN_WINDOW : credit->max_window;
+    }
+    credit->window = window < 1 ? 1 : (int)window;
+}
+
+void credit_record(credit_t *credit, const size_t message_size, const uint64_t now_ns) {
+    credit->avg_size = credit->avg_size == 0 ? message_size : 0.9 * credit->avg_size + 0.1 * message_size;
+    if (credit->interval_start_ns == 0) {
+        credit->interval_start_ns = now_ns;
+    }
+    credit->interval_count++;
+    const uint64_t elapsed = now_ns - credit->interval_start_ns;
+    if (elapsed >= CREDIT_INTERVAL_NS) {
+        double rate = credit->interval_count * 1e9 / elapsed;
+        credit->rate = credit->rate == 0 ? rate : 0.5 * credit->rate + 0.5 * rate;
+        adapt(credit);
+        credit->interval_start_ns = now_ns;
+        credit->interval_count = 0;
+    }
+}
+
+int credit_top_up(const credit_t *credit, const int link_credit) {
+    if (link_credit > credit->window / 2) {
+        return 0;
+    }
+    return credit->window - link_credit;
+}
+
+void credit_print(const credit_t *credit, const char *name, FILE *out) {
+    fprintf(out, "%s: credit window=%d rate=%.0f msg/s avg size=%.0f bytes\n",
+            name, credit->window, credit->rate, credit->avg_size);
+}
@@ -0,0 +1,82 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifndef CREDIT_H
+#define CREDIT_H 1
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/*
+ * Adaptive receiver link credit.
+ *
+ * The credit window follows the measured consume rate so that the messages
+ * the peer may have in flight to us are consumed within the latency target
+ * (window = rate * target). While credit limits the rate to about one window
+ * per round trip, a target above the round trip time makes the window grow
+ * until the consumer or the peer is the limit. The window is capped by
+ * max_window and by byte_budget divided by the average message size, so
+ * large messages get proportionally less credit.
+ * */
+typedef struct credit_t {
+  int window;               /* current credit target */
+  int max_window;
+  size_t byte_budget;       /* bytes of messages credit may be outstanding for */
+  uint64_t latency_ns;      /* target time to consume the credited messages */
+  double rate;              /* smoothed messages per second */
+  double avg_size;          /* smoothed message size in bytes */
+  uint64_t interval_start_ns;
+  uint64_t interval_count;  /* messages in the current measurement interval */
+} credit_t;
+
+/* Window before the rate has been measured */
+#define CREDIT_INITIAL_WINDOW 256
+
+#define CREDIT_MIN_WINDOW 8
+
+/* The rate is measured over intervals of this length */
+#define CREDIT_INTERVAL_NS 100000000ULL
+
+void credit_init(credit_t *credit, const int max_window, const size_t byte_budget, const int latency_ms);
+
+/*
+ * Records a consumed message and adapts the window at the end of each
+ * measurement interval.
+ * */
+void credit_record(credit_t *credit, const size_t message_size, const uint64_t now_ns);
+
+/*
+ * Returns the credit to grant to bring the link back to the window, 0 while
+ * the link still holds more than half of it.
+ *
+ * @param[in]: link_credit, the credit the link currently holds
+ * */
+int credit_top_up(const credit_t *credit, const int link_credit);
+
+/*
+ * Prints the current window, rate and average message size.
+ * */
+void credit_print(const credit_t *credit, const char *name, FILE *out);
+
+#endif /* credit.h */
@@ -0,0 +1,145 @@
+
+#include "dedup.h"
+#include "msg_view.h"
+#include "util.h"
+
+#include <proton/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int dedup_init(dedup_t *dedup, const size_t capacity, const char *key) {
+    if (capacity == 0) {
+        return -1;
+    }
+    /* keep the table at most half full so probe runs stay short */
+    size_t size = 2;
+    while (size < 2 * capacity) {
+        size *= 2;
+    }
+    dedup->ring = (uint64_t*)calloc(capacity, sizeof(uint64_t));
+    dedup->table = (uint64_t*)calloc(size, sizeof(uint64_t));
+    if (!dedup->ring || !dedup->table) {
+        free(dedup->ring);
+        free(dedup->table);
+        return -1;
+    }
+    if (strcmp(key, DEDUP_MESSAGE_ID) == 0) {
+        dedup->property = NULL;
+        dedup->property_len = 0;
+    } else {
+        dedup->property = key;
+        dedup->property_len = strlen(key);
+    }
+    dedup->capacity = capacity;
+    dedup->next = 0;
+    dedup->count = 0;
+    dedup->mask = size - 1;
+    dedup->bytes = (capacity + size) * sizeof(uint64_t);
+    dedup->checked = 0;
+    dedup->duplicates = 0;
+    dedup->unkeyed = 0;
+    return 0;
+}
+
+void dedup_free(dedup_t *dedup) {
+    free(dedup->ring);
+    free(dedup->table);
+    dedup->ring = NULL;
+    dedup->table = NULL;
+}
+
+uint64_t dedup_key(const dedup_t *dedup, const pn_bytes_t message) {
+    msg_view_t view;
+    pn_bytes_t value, bytes;
+    uint64_t number, hash;
+    if (msg_view_parse(&view, message) != 0) {
+        return 0;
+    }
+    if (!dedup->property) {
+        if (msg_view_list_get(view.properties, MSG_VIEW_MESSAGE_ID, &value) != 0) return 0;
+    } else if (msg_view_map_get(view.application_properties, dedup->property, dedup->property_len, &value) != 0) {
+        return 0;
+    }
+    if (msg_view_get_bytes(value, &bytes) == 0) {
+        hash = hash_bytes(bytes.start, bytes.size);
+    } else if (msg_view_get_ulong(value, &number) == 0) {
+        /* integers match by value whatever width they were encoded with */
+        hash = hash_bytes((const char*)&number, sizeof(number));
+    } else if (value.size > 0 && (unsigned char)value.start[0] != 0x40) {
+        /* uuid and other fixed width ids, by their encoding */
+        hash = hash_bytes(value.start, value.size);
+    } else {
+        return 0; /* null key */
+    }
+    /* 0 marks an empty table slot */
+    return hash != 0 ? hash : 1;
+}
+
+/* Table slot holding the fingerprint, or the empty slot where it would go */
+static size_t find_slot(const dedup_t *dedup, const uint64_t fingerprint) {
+    size_t i = fingerprint & dedup->mask;
+    while (dedup->table[i] != 0 && dedup->table[i] != fingerprint) {
+        i = (i + 1) & dedup->mask;
+    }
+    return i;
+}
+
+/* Removes a fingerprint, shifting later entries of its probe run back into the gap */
+static void remove_key(dedup_t *dedup, const uint64_t fingerprint) {
+    size_t gap = find_slot(dedup, fingerprint);
+    if (dedup->table[gap] == 0) {
+        return;
+    }
+    for (size_t i = (gap + 1) & dedup->mask; dedup->table[i] != 0; i = (i + 1) & dedup->mask) {
+        size_t home = dedup->table[i] & dedup->mask;
+        /* the entry may fill the gap if its home slot is not between the gap and itself */
+        if (((i - home) & dedup->mask) >= ((i - gap) & dedup->mask)) {
+            dedup->table[gap] = dedup->table[i];
+            gap = i;
+        }
+    }
+    dedup->table[gap] = 0;
+}
+
+bool dedup_seen(dedup_t *dedup, const uint64_t key) {
+    dedup->checked++;
+    if (key == 0) {
+        dedup->unkeyed++;
+        return false;
+    }
+    if (dedup->table[find_slot(dedup, key)] == key) {
+        dedup->duplicates++;
+        return true;
+    }
+    return false;
+}
+
+void dedup_record(dedup_t *dedup, const uint64_t fingerprint) {
+    if (fingerprint == 0 || dedup->table[find_slot(dedup, fingerprint)] == fingerprint) {
+        return;
+    }
+    /* the oldest key leaves the window to make room */
+    if (dedup->count == dedup->capacity) {
+        remove_key(dedup, dedup->ring[dedup->next]);
+    } else {
+        dedup->count++;
+    }
+    dedup->ring[dedup->next] = fingerprint;
+    dedup->next = (dedup->next + 1) % dedup->capacity;
+    dedup->table[find_slot(dedup, fingerprint)] = fingerprint;
+}
+
+void dedup_record_callback(void *dedup, const uint64_t key) {
+    dedup_record((dedup_t*)dedup, key);
+}
+
+void dedup_print(const dedup_t *dedup, FILE *out) {
+    fprintf(out, "dedup: %llu checked, %llu duplicates (%.3f%%), %llu without a key, window %zu keys in %zu bytes\n",
+            (unsigned long long)dedup->checked, (unsigned long long)dedup->duplicates,
+            dedup->checked > 0 ? 100.0 * dedup->duplicates / dedup->checked : 0.0,
+            (unsigned long long)dedup->unkeyed, dedup->capacity, dedup->bytes);
+}
@@ -0,0 +1,111 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+
+#ifndef DEDUP_H
+#define DEDUP_H 1
+
+
+#include <proton/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/*
+ * A fixed memory window of recently received message keys, used to spot
+ * messages the broker delivers again after a reconnect or failover.
+ *
+ * The key is the message-id, or an application property, read in place
+ * from the encoded message. A key is only recorded once its message was
+ * processed and accepted, so a message whose processing or commit failed
+ * is processed again on redelivery.
+ *
+ * Only a 64 bit fingerprint of each key is kept:
+ * a ring holds the last 'capacity' fingerprints in record order and an
+ * open addressing table indexes them. When the ring is full the oldest
+ * key is dropped from the table as the new one is added, so memory never
+ * grows past the window.
+ * */
+typedef struct dedup_t {
+  const char *property;  /* application property key, NULL for the message-id */
+  size_t property_len;
+  uint64_t *ring;        /* fingerprints in arrival order */
+  size_t capacity;       /* keys remembered */
+  size_t next;           /* ring slot the next key goes to */
+  size_t count;          /* keys in the ring */
+  uint64_t *table;       /* the ring's fingerprints, 0 marks an empty slot */
+  size_t mask;           /* table size - 1, the table is at least twice the window */
+  size_t bytes;          /* memory of the ring and the table */
+  uint64_t checked;      /* messages checked */
+  uint64_t duplicates;   /* messages whose key was in the window */
+  uint64_t unkeyed;      /* messages without a key, always passed */
+} dedup_t;
+
+/* Key name selecting the properties section message-id */
+#define DEDUP_MESSAGE_ID "message-id"
+
+/*
+ * Allocates a window of 'capacity' keys.
+ *
+ * @param[out]: dedup, the window to initialize
+ * @param[in]: capacity, the number of most recent keys remembered
+ * @param[in]: key, DEDUP_MESSAGE_ID or an application property name, must outlive the window
+ *
+ * @returns: 0 on success, -1 if capacity is 0 or allocation failed
+ * */
+int dedup_init(dedup_t *dedup, const size_t capacity, const char *key);
+
+void dedup_free(dedup_t *dedup);
+
+/*
+ * Reads the key of a received message in place.
+ *
+ * @param[in]: message, the encoded message
+ *
+ * @returns: the key fingerprint, 0 if the message has no key
+ * */
+uint64_t dedup_key(const dedup_t *dedup, const pn_bytes_t message);
+
+/*
+ * Checks a received message's key against the window without adding it.
+ * Messages without a key are never duplicates.
+ *
+ * @returns: true if the key was seen within the window
+ * */
+bool dedup_seen(dedup_t *dedup, const uint64_t key);
+
+/*
+ * Remembers the key of a message once it was processed and accepted, so a
+ * message that failed is processed again when the broker redelivers it.
+ * */
+void dedup_record(dedup_t *dedup, const uint64_t key);
+
+/*
+ * dedup_record as an ack_batch_set_accepted callback, the context is the window.
+ * */
+void dedup_record_callback(void *dedup, const uint64_t key);
+
+void dedup_print(const dedup_t *dedup, FILE *out);
+
+#endif /* dedup.h */
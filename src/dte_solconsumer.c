@@ -40,6 +40,17 @@
 #include <unistd.h>
 
 #include "util.h"
+#include "stamp.h"
+#include "recv_pool.h"
+#include "msg_view.h"
+#include "sink.h"
+#include "ack_batch.h"
+#include "credit.h"
+#include "subscription.h"
+#include "journal.h"
+#include "reconnect.h"
+#include "dedup.h"
+#include "addr_cache.h"
 
 typedef struct app_data_t {
   const char *host, *port;
@@ -49,14 +60,43 @@ typedef struct app_data_t {
   const char *amqp_address_prefix;
   const char *container_id;
   int message_count;
+  const char *output;       /* sink specification, see sink_open */
+  sink_t sink;
+  bool lazy_view;           /* read stamps and body in place instead of decoding */
+  int stats_interval;       /* seconds between latency reports, 0 for exit only */
+  int ack_batch;            /* deliveries settled together, 1 to settle each */
+  int ack_window;           /* milliseconds a delivery may be held unsettled */
+  int credit_window;        /* maximum link credit */
+  size_t credit_bytes;      /* message bytes credit may be outstanding for */
+  int credit_latency;       /* milliseconds to consume the credited messages */
+  const char *subscription_file; /* subscription list, NULL for the -n and -t subscription */
+  int sessions;             /* sessions the subscription links are spread over */
+  const char *journal_path; /* journal segment path, NULL to accept without journaling */
+  size_t journal_segment;   /* journal segment size */
+  int reconnect_attempts;   /* attempts to reopen a dropped connection, 0 to exit on a drop */
+  size_t dedup_window;      /* recent message keys checked for redeliveries, 0 for none */
+  const char *dedup_key;    /* 'message-id' or an application property identifying a message */
+  size_t address_cache;     /* bytes of formatted terminus addresses kept */
 
   pn_proactor_t *proactor;
+  char addr[PN_MAX_ADDR];   /* broker address, reconnects go to the same one */
+  pn_connection_t *connection; /* NULL once the transport is closed */
   int received;
   bool finished;
-  pn_rwbytes_t msgin;       /* Partially received message */
+  recv_buffer_t msgin;      /* Partially received message */
+  recv_pool_t pool;         /* receive buffers reused across deliveries */
+  stamp_stats_t stamps;     /* end to end latency of stamped messages */
+  ack_batch_t acks;         /* accepted deliveries waiting to be settled */
+  journal_t journal;        /* received messages made durable before they are accepted */
+  addr_cache_t addresses;   /* terminus addresses, formatted once and reused on reconnect */
+  dedup_t dedup;            /* keys of recently received messages, kept across reconnects */
+  subscription_list_t subs; /* the subscriptions attached as receiver links */
+  int outstanding;          /* credit granted over all links and not yet accepted */
+  uint64_t next_report_ns;  /* when the next periodic report is due */
+  reconnect_t reconnect;
 } app_data_t;
 
-static const int BATCH = 1000; /* Batch size for unlimited receive */
+#define RECV_POOL_IDLE 4 /* idle receive buffers kept for reuse */
 
 static int exit_code = 0;
 
@@ -67,32 +107,136 @@ extern int opterr;
 
 #define str_free(strptr) free((void *)strptr)
 
-static void check_condition(pn_event_t *e, pn_condition_t *cond) {
+static void check_condition(app_data_t *app, pn_event_t *e, pn_condition_t *cond) {
   if (pn_condition_is_set(cond)) {
     fprintf(stderr, "%s: %s: %s\n", pn_event_type_name(pn_event_type(e)),
             pn_condition_get_name(cond), pn_condition_get_description(cond));
     pn_connection_close(pn_event_connection(e));
+    /* a dropped connection is only an error once it cannot be reopened */
+    if (app->reconnect.max_attempts == 0) {
+      exit_code = 1;
+    }
+  }
+}
+
+/*
+ * Fast path for -v: find the sections in the received bytes and read only
+ * the stamps and the body from them, without decoding a pn_message_t.
+ */
+/* Returns 0 on success, 1 if the message could not be read */
+static int view_message(app_data_t *app, pn_rwbytes_t data) {
+  const uint64_t now = realtime_ns();
+  msg_view_t view;
+  int err = msg_view_parse(&view, pn_bytes(data.size, data.start));
+  if (!err) {
+    /* Record end to end latency if the sender stamped the message */
+    uint64_t sent_ns, sequence;
+    if (stamp_read_view(&view, &sent_ns, &sequence)) {
+      stamp_record(&app->stamps, sent_ns, sequence, now);
+    }
+    if (sink_wants_text(&app->sink)) {
+      /* Print the body straight from the receive buffer */
+      pn_bytes_t body;
+      char line[64];
+      struct iovec iov[3] = { { "\"", 1 }, { NULL, 0 }, { "\"\n", 2 } };
+      switch (msg_view_body(&view, &body)) {
+      case PN_STRING:
+      case PN_SYMBOL:
+        iov[1].iov_base = (void*)body.start;
+        iov[1].iov_len = body.size;
+        sink_text(&app->sink, iov, 3);
+        break;
+      case PN_BINARY:
+        iov[0].iov_base = line;
+        iov[0].iov_len = snprintf(line, sizeof(line), "<%zu bytes binary>\n", body.size);
+        sink_text(&app->sink, iov, 1);
+        break;
+      default:
+        iov[0].iov_base = "<body not inspected>\n";
+        iov[0].iov_len = strlen(iov[0].iov_base);
+        sink_text(&app->sink, iov, 1);
+        break;
+      }
+    } else {
+      sink_message(&app->sink, pn_bytes(data.size, data.start));
+    }
+  } else {
+    fprintf(stderr, "view_message: %s\n", pn_code(err));
     exit_code = 1;
+    return 1;
   }
+  return 0;
 }
 
-static void decode_message(pn_rwbytes_t data) {
+/* Returns 0 on success, 1 if the message could not be decoded */
+static int decode_message(app_data_t *app, pn_rwbytes_t data) {
+  const uint64_t now = realtime_ns();
   pn_message_t *m = pn_message();
   int err = pn_message_decode(m, data.start, data.size);
   if (!err) {
-    /* Print the decoded message */
-    pn_string_t *s = pn_string(NULL);
-    pn_inspect(pn_message_body(m), s);
-    printf("%s\n", pn_string_get(s));
-    pn_free(s);
+    /* Record end to end latency if the sender stamped the message */
+    uint64_t sent_ns, sequence;
+    if (stamp_read(m, &sent_ns, &sequence)) {
+      stamp_record(&app->stamps, sent_ns, sequence, now);
+    }
+    if (sink_wants_text(&app->sink)) {
+      /* Print the decoded message */
+      pn_string_t *s = pn_string(NULL);
+      pn_inspect(pn_message_body(m), s);
+      struct iovec iov[2] = { { (void*)pn_string_get(s), pn_string_size(s) }, { "\n", 1 } };
+      sink_text(&app->sink, iov, 2);
+      pn_free(s);
+    } else {
+      sink_message(&app->sink, pn_bytes(data.size, data.start));
+    }
     pn_message_free(m);
-    free(data.start);
   } else {
     fprintf(stderr, "decode_message: %s\n", pn_code(err));
     exit_code = 1;
+    return 1;
+  }
+  return 0;
+}
+
+/* Tops a subscription's credit up to its adaptive window, never past the messages still expected */
+static void flow_credit(app_data_t *app, subscription_t *sub) {
+  int grant = credit_top_up(&sub->credit, pn_link_credit(sub->link));
+  if (app->message_count > 0 && grant > app->message_count - app->received - app->outstanding) {
+    grant = app->message_count - app->received - app->outstanding;
+  }
+  if (grant > 0) {
+    app->outstanding += grant;
+    pn_link_flow(sub->link, grant);
   }
 }
 
+/* ack_batch released callback, messages whose commit failed are redelivered and count again then */
+static void uncount_released(void *context, const int count) {
+  app_data_t *app = (app_data_t*)context;
+  app->received -= count;
+  /* credit held back at the message count is needed for the redeliveries */
+  for (int i = 0; i < app->subs.count; i++) {
+    if (app->subs.items[i].link) {
+      flow_credit(app, &app->subs.items[i]);
+    }
+  }
+}
+
+/* The proactor timer ticks at the ack window when batching, else at the report interval */
+static int timer_interval_ms(app_data_t* app) {
+  return app->ack_batch > 1 ? app->ack_window : app->stats_interval * 1000;
+}
+
+/* Open a connection, its handlers reattach every subscription by name on every connection */
+static void connect_broker(app_data_t* app) {
+  pn_connection_t* c = pn_connection();
+  /* Initialize Sasl transport */
+  pn_transport_t *pnt = pn_transport();
+  pn_sasl_set_allow_insecure_mechs(pn_sasl(pnt), true);
+  app->connection = c;
+  pn_proactor_connect2(app->proactor, c, pnt, app->addr);
+}
+
 /* Return true to continue, false to exit */
 static bool handle(app_data_t* app, pn_event_t* event) {
   switch (pn_event_type(event)) {
@@ -106,41 +250,52 @@ static bool handle(app_data_t* app, pn_event_t* event) {
      }
      pn_connection_set_container(c, app->container_id);
      pn_connection_open(c);
+     app->connection = c;
    } break;
    
    case PN_CONNECTION_REMOTE_OPEN: {
      pn_connection_t* c = pn_event_connection(event);
-     pn_session_t* s = pn_session(c);
-     pn_session_open(s);
-     {
-     char amqp_address[PN_MAX_ADDR];
-     /*
-      * To Create a durable subscription create an AMQP Receiver link
-      * with the following:
-      * 1) set a uniquely identifiable link name
-      * 2) set an AMQP topic terminus source address using the address 
-      *    prefix 'dsub://'
-      *
-      * Where the link name is the subscription name.
-      * Where the AMQP terminus address specifies the topic and that the 
-      * subscription is durable.
-      *
-      * */
-     /* the subscription name is the name of the link */
-     pn_link_t* l = pn_receiver(s, app->subscription_name);
-     if(amqp_destination_address(amqp_address, PN_MAX_ADDR,
-                              app->amqp_address, strlen(app->amqp_address),
-                              app->amqp_address_prefix, strlen(app->amqp_address_prefix)) < 0) {
-        fprintf(stderr, "failed to format amqp terminus address\n");
-        exit_code=1;
-        return false;
-     }
-     printf("Setting amqp link terminus address to: '%s'\n", amqp_address);
-     /* set the topic on the subscription and durability */
-     pn_terminus_set_address(pn_link_source(l), amqp_address);
-     pn_link_open(l);
-     /* cannot receive without granting credit: */
-     pn_link_flow(l, app->message_count ? app->message_count : BATCH);
+     reconnect_opened(&app->reconnect, monotonic_time_ns());
+     /* spread the subscription links evenly over the sessions, in list order */
+     const int sessions = app->sessions < app->subs.count ? app->sessions : app->subs.count;
+     pn_session_t* s = NULL;
+     for (int i = 0, session = -1; i < app->subs.count; i++) {
+       subscription_t *sub = &app->subs.items[i];
+       if (i * sessions / app->subs.count != session) {
+         session = i * sessions / app->subs.count;
+         s = pn_session(c);
+         pn_session_open(s);
+       }
+       /*
+        * To Create a durable subscription create an AMQP Receiver link
+        * with the following:
+        * 1) set a uniquely identifiable link name
+        * 2) set an AMQP topic terminus source address using the address 
+        *    prefix 'dsub://'
+        *
+        * Where the link name is the subscription name.
+        * Where the AMQP terminus address specifies the topic and that the 
+        * subscription is durable.
+        *
+        * */
+       /* the subscription name is the name of the link */
+       pn_link_t* l = pn_receiver(s, sub->name);
+       sub->link = l;
+       pn_link_set_context(l, sub);
+       /* format terminus address with topic prefix, cached for reconnects */
+       const char *amqp_address = addr_cache_get(&app->addresses, sub->topic, strlen(sub->topic),
+                                                 app->amqp_address_prefix, strlen(app->amqp_address_prefix));
+       if (!amqp_address) {
+          fprintf(stderr, "failed to format amqp terminus address\n");
+          exit_code=1;
+          return false;
+       }
+       printf("Setting amqp link terminus address to: '%s'\n", amqp_address);
+       /* set the topic on the subscription and durability */
+       pn_terminus_set_address(pn_link_source(l), amqp_address);
+       pn_link_open(l);
+       /* cannot receive without granting credit: */
+       flow_credit(app, sub);
      }
    } break;
 
@@ -150,61 +305,147 @@ static bool handle(app_data_t* app, pn_event_t* event) {
      if (pn_delivery_readable(d)) {
        pn_link_t *l = pn_delivery_link(d);
        size_t size = pn_delivery_pending(d);
-       pn_rwbytes_t* m = &app->msgin; /* Append data to incoming message buffer */
+       recv_buffer_t* m = &app->msgin; /* Append data to incoming message buffer */
        int recv;
-       size_t oldsize = m->size;
-       m->size += size;
-       m->start = (char*)realloc(m->start, m->size);
-       recv = pn_link_recv(l, m->start + oldsize, m->size);
+       if (recv_pool_reserve(&app->pool, m, m->size + size) != 0) {
+         fprintf(stderr, "Unable to allocate receive buffer of %zu bytes\n", m->size + size);
+         exit(1);
+       }
+       recv = pn_link_recv(l, m->start + m->size, m->capacity - m->size);
+       if (recv > 0) {
+         m->size += recv;
+       }
        if (recv == PN_ABORTED) {
          fprintf(stderr, "Message aborted\n");
          m->size = 0;           /* Forget the data we accumulated */
          pn_delivery_settle(d); /* Free the delivery so we can receive the next message */
-         pn_link_flow(l, 1);    /* Replace credit for aborted message */
+         /* release the aborted message's credit and top up within the adaptive window */
+         app->outstanding--;
+         flow_credit(app, (subscription_t*)pn_link_get_context(l));
        } else if (recv < 0 && recv != PN_EOS) {        /* Unexpected error */
          pn_condition_format(pn_link_condition(l), "broker", "PN_DELIVERY error: %s", pn_code(recv));
          pn_link_close(l);               /* Unexpected error, close the link */
        } else if (!pn_delivery_partial(d)) { /* Message is complete */
-         decode_message(*m);
-         *m = pn_rwbytes_null;  /* Reset the buffer for the next message*/
-         /* Accept the delivery */
-         pn_delivery_update(d, PN_ACCEPTED);
-         pn_delivery_settle(d);  /* settle and free d */
-         if (app->message_count == 0) {
-           /* receive forever - see if more credit is needed */
-           if (pn_link_credit(l) < BATCH/2) {
-             /* Grant enough credit to bring it up to BATCH: */
-             pn_link_flow(l, BATCH - pn_link_credit(l));
-           }
-         } else if (++app->received >= app->message_count) {
-           pn_session_t *ssn = pn_link_session(l);
+         subscription_t *sub = (subscription_t*)pn_link_get_context(l);
+         /* a redelivered message is accepted again without being journaled or processed */
+         uint64_t key = app->dedup_window > 0 ? dedup_key(&app->dedup, pn_bytes(m->size, m->start)) : 0;
+         const bool duplicate = app->dedup_window > 0 && dedup_seen(&app->dedup, key);
+         /* store the message as received, it is committed before its batch is accepted */
+         if (!duplicate && app->journal_path && journal_append(&app->journal, pn_bytes(m->size, m->start)) != 0) {
+           fprintf(stderr, "Unable to journal a message of %zu bytes\n", m->size);
+           exit_code = 1;
+           pn_connection_close(pn_event_connection(event));
+           break;
+         }
+         if (duplicate) {
+           /* already output when it was first received, its key is in the window */
+           key = 0;
+         } else if ((app->lazy_view ? view_message(app, pn_rwbytes(m->size, m->start))
+                                    : decode_message(app, pn_rwbytes(m->size, m->start))) != 0) {
+           key = 0; /* not remembered, a redelivery is processed again */
+         }
+         credit_record(&sub->credit, m->size, monotonic_time_ns());
+         sub->received++;
+         sub->bytes += m->size;
+         recv_pool_put(&app->pool, m);  /* Reuse the buffer for the next message */
+         /* Accept the delivery, settled now or with the rest of its batch, its key is remembered once accepted */
+         ack_batch_add(&app->acks, d, key, !duplicate, monotonic_time_ns());
+         app->outstanding--;
+         if (!duplicate) {
+           app->received++;  /* -c counts unique messages */
+         }
+         if (app->message_count > 0 && app->received >= app->message_count) {
+           /* a failed commit releases the batch and takes it back out of the count */
+           ack_batch_flush(&app->acks);
+         }
+         if (app->message_count > 0 && app->received >= app->message_count) {
            printf("%d messages received\n", app->received);
-           pn_link_close(l);
-           pn_session_close(ssn);
-           pn_connection_close(pn_session_connection(ssn));
+           app->finished = true;
+           pn_connection_close(pn_event_connection(event));
+         } else {
+           /* see if more credit is needed */
+           flow_credit(app, sub);
          }
        }
      }
      break;
    }
 
+   case PN_CONNECTION_WAKE:
+    /* ack window tick, settle held deliveries from the connection's own event batch */
+    ack_batch_flush_due(&app->acks, monotonic_time_ns());
+    break;
+
+   case PN_PROACTOR_TIMEOUT: {
+    /* periodic report, keep ticking while the connection is open */
+    uint64_t now = monotonic_time_ns();
+    if (reconnect_pending(&app->reconnect)) {
+      if (reconnect_due(&app->reconnect, now)) {
+        connect_broker(app);
+        if (app->stats_interval > 0 || app->ack_batch > 1) {
+          pn_proactor_set_timeout(app->proactor, timer_interval_ms(app));
+        }
+      } else {
+        pn_proactor_set_timeout(app->proactor, reconnect_wait_ms(&app->reconnect, now));
+      }
+      break;
+    }
+    if (app->stats_interval > 0 && now >= app->next_report_ns) {
+      stamp_print(&app->stamps, "e2e latency", stdout);
+      for (int i = 0; i < app->subs.count; i++) {
+        subscription_print(&app->subs.items[i], stdout);
+      }
+      app->next_report_ns = now + (uint64_t)app->stats_interval * 1000000000;
+    }
+    if (app->connection) {
+      if (app->ack_batch > 1) {
+        pn_connection_wake(app->connection);
+      }
+      pn_proactor_set_timeout(app->proactor, timer_interval_ms(app));
+    }
+    break;
+   }
+
    case PN_TRANSPORT_CLOSED:
-    check_condition(event, pn_transport_condition(pn_event_transport(event)));
+    check_condition(app, event, pn_transport_condition(pn_event_transport(event)));
+    app->connection = NULL;
+    /* the acks still batched are lost, the broker may redeliver their messages */
+    size_t unsettled = app->acks.count;
+    app->received -= app->acks.counted;  /* they count again when redelivered */
+    ack_batch_discard(&app->acks);
+    app->msgin.size = 0;
+    app->outstanding = 0;
+    for (int i = 0; i < app->subs.count; i++) {
+      app->subs.items[i].link = NULL;
+    }
+    if (!app->finished && app->reconnect.max_attempts > 0) {
+      if (reconnect_schedule(&app->reconnect, monotonic_time_ns())) {
+        app->reconnect.acks_discarded += unsettled;
+        pn_proactor_set_timeout(app->proactor, reconnect_wait_ms(&app->reconnect, monotonic_time_ns()));
+        break;
+      }
+      fprintf(stderr, "Giving up after %d reconnect attempts\n", app->reconnect.max_attempts);
+      exit_code = 1;
+    }
+    if (app->stats_interval > 0 || app->ack_batch > 1) {
+      /* don't hold the proactor open until the next tick */
+      pn_proactor_cancel_timeout(app->proactor);
+    }
     break;
 
    case PN_CONNECTION_REMOTE_CLOSE:
-    check_condition(event, pn_connection_remote_condition(pn_event_connection(event)));
+    check_condition(app, event, pn_connection_remote_condition(pn_event_connection(event)));
     pn_connection_close(pn_event_connection(event));
     break;
 
    case PN_SESSION_REMOTE_CLOSE:
-    check_condition(event, pn_session_remote_condition(pn_event_session(event)));
+    check_condition(app, event, pn_session_remote_condition(pn_event_session(event)));
     pn_connection_close(pn_event_connection(event));
     break;
 
    case PN_LINK_REMOTE_CLOSE:
    case PN_LINK_REMOTE_DETACH:
-    check_condition(event, pn_link_remote_condition(pn_event_link(event)));
+    check_condition(app, event, pn_link_remote_condition(pn_event_link(event)));
     pn_connection_close(pn_event_connection(event));
     break;
 
@@ -240,9 +481,25 @@ void usage() {
     printf("\t-c      # of messages to consume [10]\n");
     printf("\t-t      Target topic address [my_topic]\n");
     printf("\t-n      Subscription name [my_sub]\n");
+    printf("\t-F      Subscription list file, a subscription name and topic per line, instead of -n and -t []\n");
+    printf("\t-S      # of sessions the subscriptions are spread over [1]\n");
     printf("\t-i      Container name [dte_sol_consumer]\n");
     printf("\t-u      Client authentication username []\n");
     printf("\t-P      Client authentication password []\n");
+    printf("\t-o      Message output: print, quiet (count only), text (batched writes) or dump:<file> (length prefixed binary) [print]\n");
+    printf("\t-v      Inspect messages in place without a full decode [false]\n");
+    printf("\t-w      Maximum link credit [10000]\n");
+    printf("\t-m      Maximum bytes of messages credit is granted for [67108864]\n");
+    printf("\t-L      Latency target in milliseconds for consuming credited messages [100]\n");
+    printf("\t-A      # of accepted deliveries settled together, 1 to settle each [1]\n");
+    printf("\t-W      Milliseconds an accepted delivery may wait for its batch [5]\n");
+    printf("\t-j      Journal messages to segment files <path>.<n> before accepting them, committed per -A batch []\n");
+    printf("\t-J      Journal segment size in bytes [67108864]\n");
+    printf("\t-D      # of recent message keys checked to accept redeliveries without processing them, 0 for none [0]\n");
+    printf("\t-d      Key identifying a message for -D: message-id or an application property name [message-id]\n");
+    printf("\t-M      Bytes of formatted subscription addresses cached across reconnects [4194304]\n");
+    printf("\t-R      Reconnect attempts after the connection drops, with exponential backoff, 0 to exit on a drop [0]\n");
+    printf("\t-I      Seconds between end to end latency reports, 0 to report at exit only [0]\n");
     printf("\t-h      Displays this message\n");
     exit(0);
 
@@ -268,6 +525,22 @@ void parse_args(int argc, char **argv, app_data_t *app) {
     app->message_count = 10;
     app->username = NULL;
     app->password = NULL;
+    app->stats_interval = 0;
+    app->lazy_view = false;
+    app->output = "print";
+    app->ack_batch = 1;
+    app->credit_window = 10000;
+    app->credit_bytes = 64 * 1024 * 1024;
+    app->credit_latency = 100;
+    app->ack_window = 5;
+    app->subscription_file = NULL;
+    app->sessions = 1;
+    app->reconnect_attempts = 0;
+    app->dedup_window = 0;
+    app->dedup_key = DEDUP_MESSAGE_ID;
+    app->address_cache = 4 * 1024 * 1024;
+    app->journal_path = NULL;
+    app->journal_segment = 64 * 1024 * 1024;
 
     /*
      * The 'dsub://' is the address prefix for durable subscriptions for the
@@ -277,7 +550,7 @@ void parse_args(int argc, char **argv, app_data_t *app) {
 
     /* command line options */
     opterr = 0;
-    while((c = getopt(argc, argv, "i:a:c:t:p:u:P:n:h")) != -1) {
+    while((c = getopt(argc, argv, "i:a:c:t:p:u:P:n:I:vo:A:W:w:m:L:F:S:j:J:R:D:d:M:h")) != -1) {
         switch(c) {
         case 'h': usage(); break;
         case 'c':
@@ -295,9 +568,55 @@ void parse_args(int argc, char **argv, app_data_t *app) {
             break;
         case 't': app->amqp_address = optarg; break;
         case 'n': app->subscription_name = optarg; break;
+        case 'F': app->subscription_file = optarg; break;
+        case 'j': app->journal_path = optarg; break;
+        case 'J':
+            if (parse_size(optarg, &app->journal_segment) != 0 || app->journal_segment <= JOURNAL_RECORD_HEADER) usage();
+            break;
+        case 'M':
+            if (parse_size(optarg, &app->address_cache) != 0) usage();
+            break;
+        case 'D':
+            if (parse_size(optarg, &app->dedup_window) != 0) usage();
+            break;
+        case 'd': app->dedup_key = optarg; break;
+        case 'R':
+            app->reconnect_attempts = atoi(optarg);
+            if (app->reconnect_attempts < 0) usage();
+            break;
+        case 'S':
+            app->sessions = atoi(optarg);
+            if (app->sessions <= 0) usage();
+            break;
         case 'p': app->port = optarg; break;
         case 'u': app->username = optarg; break;
         case 'P': app->password = optarg; break;
+        case 'v': app->lazy_view = true; break;
+        case 'o': app->output = optarg; break;
+        case 'A':
+            app->ack_batch = atoi(optarg);
+            if (app->ack_batch <= 0) usage();
+            break;
+        case 'w':
+            app->credit_window = atoi(optarg);
+            if (app->credit_window <= 0) usage();
+            break;
+        case 'm':
+            app->credit_bytes = strtoul(optarg, NULL, 10);
+            if (app->credit_bytes == 0) usage();
+            break;
+        case 'L':
+            app->credit_latency = atoi(optarg);
+            if (app->credit_latency <= 0) usage();
+            break;
+        case 'W':
+            app->ack_window = atoi(optarg);
+            if (app->ack_window <= 0) usage();
+            break;
+        case 'I':
+            app->stats_interval = atoi(optarg);
+            if (app->stats_interval < 0) usage();
+            break;
         default: usage(); break;
         }
     }
@@ -306,23 +625,109 @@ void parse_args(int argc, char **argv, app_data_t *app) {
 
 int main(int argc, char **argv) {
     struct app_data_t app = {0};
-    char addr[PN_MAX_ADDR];
 
     parse_args(argc, argv, &app);
+    if (sink_open(&app.sink, app.output) != 0) {
+        fprintf(stderr, "Invalid message output: %s\n", app.output);
+        usage();
+    }
+    if (ack_batch_init(&app.acks, app.ack_batch, app.ack_window) != 0) {
+        fprintf(stderr, "Unable to allocate ack batch of %d deliveries\n", app.ack_batch);
+        exit(1);
+    }
+    if (app.journal_path) {
+        if (journal_open(&app.journal, app.journal_path, app.journal_segment) != 0) {
+            fprintf(stderr, "Unable to open journal: %s\n", app.journal_path);
+            exit(1);
+        }
+        /* group commit: one msync per ack batch, then the whole batch is accepted */
+        ack_batch_set_commit(&app.acks, journal_commit_callback, &app.journal);
+        /* only messages made durable count toward -c */
+        ack_batch_set_released(&app.acks, uncount_released, &app);
+    }
+    if (app.subscription_file) {
+        int rc = subscription_list_load(&app.subs, app.subscription_file);
+        if (rc < 0) {
+            fprintf(stderr, "Unable to read subscription list: %s\n", app.subscription_file);
+            exit(1);
+        } else if (rc > 0) {
+            fprintf(stderr, "%s:%d: expected a subscription name and topic\n", app.subscription_file, rc);
+            exit(1);
+        } else if (app.subs.count == 0) {
+            fprintf(stderr, "No subscriptions in %s\n", app.subscription_file);
+            exit(1);
+        }
+    } else if (subscription_list_add(&app.subs, app.subscription_name, app.amqp_address) != 0) {
+        fprintf(stderr, "Unable to allocate subscription\n");
+        exit(1);
+    }
+    /* -w and -m are shared fairly by the subscriptions */
+    subscription_list_credit(&app.subs, app.credit_window, app.credit_bytes, app.credit_latency);
+    reconnect_init(&app.reconnect, app.reconnect_attempts);
+    if (addr_cache_init(&app.addresses, app.address_cache) != 0) {
+        fprintf(stderr, "Unable to allocate address cache\n");
+        exit(1);
+    }
+    if (app.dedup_window > 0) {
+        if (dedup_init(&app.dedup, app.dedup_window, app.dedup_key) != 0) {
+            fprintf(stderr, "Unable to allocate dedup window of %zu keys\n", app.dedup_window);
+            exit(1);
+        }
+        /* a key enters the window once its message is accepted, after any journal commit */
+        ack_batch_set_accepted(&app.acks, dedup_record_callback, &app.dedup);
+    }
+    app.next_report_ns = monotonic_time_ns() + (uint64_t)app.stats_interval * 1000000000;
+    if (recv_pool_init(&app.pool, RECV_POOL_IDLE) != 0) {
+        fprintf(stderr, "Unable to allocate receive buffer pool\n");
+        exit(1);
+    }
 
     /* Create the proactor and connect */
     app.proactor = pn_proactor();
-    pn_proactor_addr(addr, sizeof(addr), app.host, app.port);
-    fprintf(stdout, "Connecting to host: %s\n", addr);
-
-    /* Initialize Sasl transport */
-    pn_transport_t *pnt = pn_transport();
-    pn_sasl_set_allow_insecure_mechs(pn_sasl(pnt), true);
-
-    pn_proactor_connect2(app.proactor, NULL, pnt, addr);
-    fprintf(stdout, "waiting to receive %d messages from amqp address: %s\n", app.message_count, app.amqp_address);
+    pn_proactor_addr(app.addr, sizeof(app.addr), app.host, app.port);
+    fprintf(stdout, "Connecting to host: %s\n", app.addr);
+    connect_broker(&app);
+    if (app.subscription_file) {
+        fprintf(stdout, "waiting to receive %d messages from %d subscriptions\n", app.message_count, app.subs.count);
+    } else {
+        fprintf(stdout, "waiting to receive %d messages from amqp address: %s\n", app.message_count, app.amqp_address);
+    }
+    if (app.stats_interval > 0 || app.ack_batch > 1) {
+        pn_proactor_set_timeout(app.proactor, timer_interval_ms(&app));
+    }
     run(&app);
+    sink_close(&app.sink);
+    if (app.acks.released > 0) {
+        exit_code = 1;  /* a journal commit failed */
+    }
+    if (sink_failed(&app.sink)) {
+        exit_code = 1;
+    }
+    stamp_print(&app.stamps, "e2e latency", stdout);
+    for (int i = 0; i < app.subs.count; i++) {
+        subscription_print(&app.subs.items[i], stdout);
+    }
+    recv_pool_print(&app.pool, stdout);
+    ack_batch_print(&app.acks, stdout);
+    if (app.reconnect_attempts > 0) {
+        reconnect_print(&app.reconnect, stdout);
+    }
+    if (app.journal_path) {
+        journal_close(&app.journal);
+        journal_print(&app.journal, stdout);
+    }
+    addr_cache_print(&app.addresses, stdout);
+    addr_cache_free(&app.addresses);
+    if (app.dedup_window > 0) {
+        dedup_print(&app.dedup, stdout);
+        dedup_free(&app.dedup);
+    }
+    sink_print(&app.sink, stdout);
     pn_proactor_free(app.proactor);
+    recv_pool_put(&app.pool, &app.msgin);
+    recv_pool_free(&app.pool);
+    ack_batch_free(&app.acks);
+    subscription_list_free(&app.subs);
     str_free(app.container_id);
     return exit_code;
 }
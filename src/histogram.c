@@ -0,0 +1,87 @@
+
+#include "histogram.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Values below HISTOGRAM_HALF_SUB map to their own bucket. Larger values
+ * are shifted right until they fit in HISTOGRAM_SUB_BITS, the shift selects
+ * the power of two range and the remaining bits the bucket inside it.
+ * */
+static unsigned bucket_index(uint64_t value) {
+    if (value < HISTOGRAM_HALF_SUB) {
+        return (unsigned)value;
+    }
+    unsigned msb = 63 - __builtin_clzll(value);
+    unsigned shift = msb < HISTOGRAM_SUB_BITS ? 0 : msb - HISTOGRAM_SUB_BITS + 1;
+    return shift * HISTOGRAM_HALF_SUB + (unsigned)(value >> shift);
+}
+
+/* highest value that maps to the bucket at index */
+static uint64_t bucket_highest_value(unsigned index) {
+    if (index < HISTOGRAM_HALF_SUB) {
+        return index;
+    }
+    unsigned shift = index / HISTOGRAM_HALF_SUB - 1;
+    uint64_t sub = index - shift * HISTOGRAM_HALF_SUB;
+    return ((sub + 1) << shift) - 1;
+}
+
+void histogram_record(histogram_t *h, uint64_t value) {
+    if (h->total == 0 || value < h->min) {
+        h->min = value;
+    }
+    if (value > h->max) {
+        h->max = value;
+    }
+    h->counts[bucket_index(value)]++;
+    h->total++;
+}
+
+void histogram_merge(histogram_t *dest, const histogram_t *src) {
+    if (src->total == 0) {
+        return;
+    }
+    if (dest->total == 0 || src->min < dest->min) {
+        dest->min = src->min;
+    }
+    if (src->max > dest->max) {
+        dest->max = src->max;
+    }
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        dest->counts[i] += src->counts[i];
+    }
+    dest->total += src->total;
+}
+
+uint64_t histogram_percentile(const histogram_t *h, double percentile) {
+    if (h->total == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)(percentile / 100.0 * h->total + 0.5);
+    if (target == 0) {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= target) {
+            uint64_t value = bucket_highest_value(i);
+            return value > h->max ? h->max : value;
+        }
+    }
+    return h->max;
+}
+
+#define NS_PER_US 1000.0
+
+void histogram_print(const histogram_t *h, const char *name, FILE *out) {
+    fprintf(out, "%s: count=%llu min=%.1fus p50=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus\n",
+            name, (unsigned long long)h->total,
+            h->min / NS_PER_US,
+            histogram_percentile(h, 50.0) / NS_PER_US,
+            histogram_percentile(h, 99.0) / NS_PER_US,
+            histogram_percentile(h, 99.9) / NS_PER_US,
+            h->max / NS_PER_US);
+}
@@ -0,0 +1,79 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H 1
+
+
+#include <stdint.h>
+#include <stdio.h>
+
+
+/*
+ * Number of bits of precision kept for each recorded value. Values are
+ * bucketed log-linear (HDR style), each power of two range is split into
+ * 2^(HISTOGRAM_SUB_BITS-1) buckets, about 1.5% relative error.
+ * */
+#define HISTOGRAM_SUB_BITS 7
+
+#define HISTOGRAM_HALF_SUB (1 << (HISTOGRAM_SUB_BITS - 1))
+
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 2) * HISTOGRAM_HALF_SUB)
+
+/*
+ * Fixed memory histogram of unsigned 64 bit values, typically nanoseconds.
+ * Zero initialize before use, recording never allocates.
+ * */
+typedef struct histogram_t {
+  uint64_t counts[HISTOGRAM_BUCKETS];
+  uint64_t total;
+  uint64_t min;
+  uint64_t max;
+} histogram_t;
+
+/*
+ * Adds a value to the histogram.
+ * */
+void histogram_record(histogram_t *h, uint64_t value);
+
+/*
+ * Adds all the values recorded in src to dest.
+ * */
+void histogram_merge(histogram_t *dest, const histogram_t *src);
+
+/*
+ * Returns the value at the given percentile, eg. 99.9, or 0 when empty.
+ * The returned value is the highest value equivalent to the bucket
+ * holding the percentile.
+ * */
+uint64_t histogram_percentile(const histogram_t *h, double percentile);
+
+/*
+ * Prints count, min, p50, p99, p99.9 and max on one line with values
+ * converted from nanoseconds to microseconds.
+ *
+ * @param[in]: h, the histogram of nanosecond values
+ * @param[in]: name, label printed at the start of the line
+ * @param[in]: out, the stream to print to
+ * */
+void histogram_print(const histogram_t *h, const char *name, FILE *out);
+
+#endif /* histogram.h */
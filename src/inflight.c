@@ -0,0 +1,69 @@
+
+#include "inflight.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+int inflight_init(inflight_t *ring, const size_t capacity) {
+    if (capacity == 0) {
+        return -1;
+    }
+    ring->records = (inflight_record_t*)calloc(capacity, sizeof(inflight_record_t));
+    if (ring->records == NULL) {
+        return -1;
+    }
+    ring->capacity = capacity;
+    ring->count = 0;
+    return 0;
+}
+
+void inflight_free(inflight_t *ring) {
+    free(ring->records);
+    ring->records = NULL;
+    ring->capacity = 0;
+    ring->count = 0;
+}
+
+bool inflight_available(const inflight_t *ring, const int tag) {
+    return ring->records[(unsigned)tag % ring->capacity].tag == 0;
+}
+
+void inflight_add(inflight_t *ring, const int tag, const uint64_t sent_ns) {
+    inflight_record_t *r = &ring->records[(unsigned)tag % ring->capacity];
+    r->tag = tag;
+    r->sent_ns = sent_ns;
+    ring->count++;
+}
+
+bool inflight_remove(inflight_t *ring, const int tag, uint64_t *sent_ns) {
+    inflight_record_t *r = &ring->records[(unsigned)tag % ring->capacity];
+    if (r->tag != tag || tag == 0) {
+        return false;
+    }
+    if (sent_ns) {
+        *sent_ns = r->sent_ns;
+    }
+    r->tag = 0;
+    ring->count--;
+    return true;
+}
+
+static int compare_tags(const void *a, const void *b) {
+    const int x = *(const int*)a, y = *(const int*)b;
+    return x < y ? -1 : x > y;
+}
+
+size_t inflight_drain(inflight_t *ring, int *tags) {
+    size_t count = 0;
+    for (size_t i = 0; i < ring->capacity; i++) {
+        if (ring->records[i].tag != 0) {
+            tags[count++] = ring->records[i].tag;
+            ring->records[i].tag = 0;
+        }
+    }
+    ring->count = 0;
+    /* the ring order wraps, resend oldest first */
+    qsort(tags, count, sizeof(int), compare_tags);
+    return count;
+}
@@ -0,0 +1,92 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifndef INFLIGHT_H
+#define INFLIGHT_H 1
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/*
+ * Record of one unsettled outgoing delivery.
+ * */
+typedef struct inflight_record_t {
+  int tag;           /* delivery tag, 0 when the slot is free */
+  uint64_t sent_ns;  /* monotonic time the delivery was sent */
+} inflight_record_t;
+
+/*
+ * Fixed size ring of unsettled deliveries indexed by delivery tag.
+ * Delivery tags are expected to be increasing integers, a tag uses
+ * slot 'tag % capacity'. A new tag is only admitted when its slot is free,
+ * which bounds the number of unsettled deliveries to the ring capacity.
+ * */
+typedef struct inflight_t {
+  inflight_record_t *records;
+  size_t capacity;
+  size_t count;      /* number of occupied slots */
+} inflight_t;
+
+/*
+ * Allocates the ring records.
+ *
+ * @returns: 0 on success, -1 if capacity is 0 or allocation failed
+ * */
+int inflight_init(inflight_t *ring, const size_t capacity);
+
+/*
+ * Frees the ring records.
+ * */
+void inflight_free(inflight_t *ring);
+
+/*
+ * Returns true if the slot for tag is free and tag can be added.
+ * */
+bool inflight_available(const inflight_t *ring, const int tag);
+
+/*
+ * Stores the send time for tag. The caller must check inflight_available first.
+ * */
+void inflight_add(inflight_t *ring, const int tag, const uint64_t sent_ns);
+
+/*
+ * Clears the slot for tag.
+ * parameter out:
+ *      sent_ns: the time tag was added, may be NULL
+ * returns:
+ *      true if tag was in the ring, false otherwise
+ * */
+bool inflight_remove(inflight_t *ring, const int tag, uint64_t *sent_ns);
+
+/*
+ * Removes every tag from the ring, for resending the deliveries of a
+ * connection that closed.
+ * parameter out:
+ *      tags: the removed tags in ascending order, room for the ring capacity
+ * returns:
+ *      the number of tags removed
+ * */
+size_t inflight_drain(inflight_t *ring, int *tags);
+
+#endif /* inflight.h */
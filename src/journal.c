@@ -0,0 +1,165 @@
+
+#include "journal.h"
+
+#include <proton/types.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static void segment_name(const journal_t *journal, const unsigned index, char *name, const size_t size) {
+    snprintf(name, size, "%s.%06u", journal->path, index);
+}
+
+/* Creates and maps the segment at the journal's index */
+static int open_segment(journal_t *journal) {
+    char name[PATH_MAX];
+    segment_name(journal, journal->index, name, sizeof(name));
+    int fd = open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        perror(name);
+        return -1;
+    }
+    /* allocate the blocks up front so appends to the mapping never fault on a full disk */
+    int err = posix_fallocate(fd, 0, journal->segment_size);
+    if (err != 0) {
+        fprintf(stderr, "Unable to allocate journal segment %s: %s\n", name, strerror(err));
+        close(fd);
+        unlink(name);
+        return -1;
+    }
+    void *base = mmap(NULL, journal->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        perror(name);
+        close(fd);
+        unlink(name);
+        return -1;
+    }
+    madvise(base, journal->segment_size, MADV_SEQUENTIAL);
+    journal->fd = fd;
+    journal->base = (char*)base;
+    journal->offset = 0;
+    journal->synced = 0;
+    journal->segments++;
+    return 0;
+}
+
+static void close_segment(journal_t *journal) {
+    if (!journal->base) {
+        return;
+    }
+    journal_commit(journal);
+    munmap(journal->base, journal->segment_size);
+    /* drop the preallocated tail, the records end at the end of the file */
+    if (ftruncate(journal->fd, journal->offset) != 0) {
+        perror("journal segment truncate");
+    }
+    close(journal->fd);
+    journal->base = NULL;
+    journal->fd = -1;
+}
+
+int journal_open(journal_t *journal, const char *path, const size_t segment_size) {
+    memset(journal, 0, sizeof(*journal));
+    journal->fd = -1;
+    if (segment_size <= JOURNAL_RECORD_HEADER) {
+        return -1;
+    }
+    journal->path = strdup(path);
+    journal->segment_size = segment_size;
+    /* never overwrite a segment, start after the ones already there */
+    char name[PATH_MAX];
+    for (segment_name(journal, 0, name, sizeof(name)); access(name, F_OK) == 0;
+         segment_name(journal, ++journal->index, name, sizeof(name))) {
+    }
+    if (open_segment(journal) != 0) {
+        free(journal->path);
+        journal->path = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int journal_append(journal_t *journal, const pn_bytes_t message) {
+    const size_t size = JOURNAL_RECORD_HEADER + message.size;
+    if (size > journal->segment_size || message.size > UINT32_MAX) {
+        return -1;
+    }
+    if (journal->offset + size > journal->segment_size) {
+        close_segment(journal);
+        journal->index++;
+        if (open_segment(journal) != 0) {
+            return -1;
+        }
+    }
+    unsigned char *p = (unsigned char*)journal->base + journal->offset;
+    p[0] = (unsigned char)(message.size >> 24);
+    p[1] = (unsigned char)(message.size >> 16);
+    p[2] = (unsigned char)(message.size >> 8);
+    p[3] = (unsigned char)message.size;
+    memcpy(p + JOURNAL_RECORD_HEADER, message.start, message.size);
+    journal->offset += size;
+    journal->records++;
+    journal->bytes += message.size;
+    return 0;
+}
+
+int journal_commit(journal_t *journal) {
+    if (!journal->base || journal->offset == journal->synced) {
+        return 0;
+    }
+    /* msync needs a page aligned start, rewrite the partial page of the previous commit */
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t start = journal->synced / page * page;
+    if (msync(journal->base + start, journal->offset - start, MS_SYNC) != 0) {
+        perror("journal msync");
+        return -1;
+    }
+    journal->synced = journal->offset;
+    journal->commits++;
+    return 0;
+}
+
+int journal_commit_callback(void *journal) {
+    return journal_commit((journal_t*)journal);
+}
+
+void journal_close(journal_t *journal) {
+    close_segment(journal);
+    free(journal->path);
+    journal->path = NULL;
+}
+
+int journal_next(const pn_bytes_t segment, size_t *offset, pn_bytes_t *record) {
+    if (*offset + JOURNAL_RECORD_HEADER > segment.size) {
+        return *offset == segment.size ? 0 : -1;
+    }
+    const unsigned char *p = (const unsigned char*)segment.start + *offset;
+    const size_t size = ((size_t)p[0] << 24) | ((size_t)p[1] << 16) | ((size_t)p[2] << 8) | p[3];
+    if (size == 0) {
+        return 0;  /* preallocated space of a segment that was not closed */
+    }
+    if (*offset + JOURNAL_RECORD_HEADER + size > segment.size) {
+        return -1;
+    }
+    *record = pn_bytes(size, (const char*)p + JOURNAL_RECORD_HEADER);
+    *offset += JOURNAL_RECORD_HEADER + size;
+    return 1;
+}
+
+void journal_merge(journal_t *dest, const journal_t *src) {
+    dest->records += src->records;
+    dest->bytes += src->bytes;
+    dest->commits += src->commits;
+    dest->segments += src->segments;
+}
+
+void journal_print(const journal_t *journal, FILE *out) {
+    fprintf(out, "journal: %llu messages, %llu bytes in %llu commits over %llu segments\n",
+            (unsigned long long)journal->records, (unsigned long long)journal->bytes,
+            (unsigned long long)journal->commits, (unsigned long long)journal->segments);
+}
@@ -0,0 +1,117 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+
+#ifndef JOURNAL_H
+#define JOURNAL_H 1
+
+
+#include <proton/types.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/*
+ * An append only journal of received messages, kept in memory mapped
+ * segment files named <path>.<index>.
+ *
+ * Each record is the encoded message with a 4 byte big endian length
+ * prefix, the same framing as the dump sink. Segments are preallocated
+ * to the segment size, a zero length marks the end of the records and
+ * the unused tail is truncated when the segment is closed. Appends only
+ * copy into the mapping, journal_commit writes everything appended since
+ * the previous commit to disk with a single msync.
+ * */
+typedef struct journal_t {
+  char *path;            /* segment files are <path>.<index> */
+  size_t segment_size;
+  int fd;                /* the current segment */
+  char *base;            /* the current segment mapping */
+  unsigned index;        /* the current segment's index */
+  size_t offset;         /* where the next record goes */
+  size_t synced;         /* bytes of the segment written to disk */
+  uint64_t records;      /* records appended */
+  uint64_t bytes;        /* message bytes appended */
+  uint64_t commits;      /* msyncs, each covering a group of records */
+  uint64_t segments;     /* segments opened */
+} journal_t;
+
+/* Bytes of the length ahead of each record */
+#define JOURNAL_RECORD_HEADER 4
+
+/*
+ * Opens a new segment after any existing segments of the path.
+ *
+ * @param[out]: journal, the journal to initialize
+ * @param[in]: path, the segment file name without the index
+ * @param[in]: segment_size, the size segments are preallocated to
+ *
+ * @returns: 0 on success, -1 if the segment cannot be created
+ * */
+int journal_open(journal_t *journal, const char *path, const size_t segment_size);
+
+/*
+ * Copies a message into the journal, rolling over to a new segment when
+ * the current one is full. The message is not durable until committed.
+ *
+ * @returns: 0 on success, -1 if the message is larger than a segment or a
+ *           new segment cannot be created
+ * */
+int journal_append(journal_t *journal, const pn_bytes_t message);
+
+/*
+ * Writes the records appended since the last commit to disk.
+ *
+ * @returns: 0 on success, -1 if the write failed
+ * */
+int journal_commit(journal_t *journal);
+
+/*
+ * journal_commit as an ack_batch_set_commit callback, the context is the journal.
+ * */
+int journal_commit_callback(void *journal);
+
+/*
+ * Commits, truncates the unused tail of the segment and closes it.
+ * */
+void journal_close(journal_t *journal);
+
+/*
+ * Reads the record at offset in a segment and advances the offset past it.
+ *
+ * @returns: 1 if a record was read, 0 at the end of the records, -1 if the
+ *           segment ends inside a record
+ * */
+int journal_next(const pn_bytes_t segment, size_t *offset, pn_bytes_t *record);
+
+/*
+ * Adds the counters of src to dest.
+ * */
+void journal_merge(journal_t *dest, const journal_t *src);
+
+/*
+ * Prints the records appended and the commits they took.
+ * */
+void journal_print(const journal_t *journal, FILE *out);
+
+#endif /* journal.h */
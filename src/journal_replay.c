@@ -0,0 +1,181 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ * 
+ * journal_replay
+ *
+ * This sample reads back the journal segments written by the consumers'
+ * -j option and outputs the messages they hold, without a broker.
+ * Segments are memory mapped and read sequentially, the pages already
+ * read are dropped as it goes so large journals replay at disk speed.
+ */
+
+#include <proton/codec.h>
+#include <proton/types.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "mapped_file.h"
+#include "journal.h"
+#include "msg_view.h"
+#include "sink.h"
+
+/* Pages read are dropped from the resident set in steps of this size */
+#define REPLAY_RELEASE_STEP (8 * 1024 * 1024)
+
+typedef struct app_data_t {
+  const char *output;       /* sink specification, see sink_open */
+  sink_t sink;
+  uint64_t messages;
+  uint64_t bytes;
+} app_data_t;
+
+extern int optind;
+extern char* optarg;
+extern int optopt;
+extern int opterr;
+
+/* Outputs a journaled message, printing the body in place when text is wanted */
+static void output_message(app_data_t *app, pn_bytes_t message) {
+  if (!sink_wants_text(&app->sink)) {
+    sink_message(&app->sink, message);
+    return;
+  }
+  msg_view_t view;
+  pn_bytes_t body;
+  char line[64];
+  struct iovec iov[3] = { { "\"", 1 }, { NULL, 0 }, { "\"\n", 2 } };
+  if (msg_view_parse(&view, message) != 0) {
+    iov[0].iov_base = "<invalid message>\n";
+    iov[0].iov_len = strlen(iov[0].iov_base);
+    sink_text(&app->sink, iov, 1);
+    return;
+  }
+  switch (msg_view_body(&view, &body)) {
+  case PN_STRING:
+  case PN_SYMBOL:
+    iov[1].iov_base = (void*)body.start;
+    iov[1].iov_len = body.size;
+    sink_text(&app->sink, iov, 3);
+    break;
+  case PN_BINARY:
+    iov[0].iov_base = line;
+    iov[0].iov_len = snprintf(line, sizeof(line), "<%zu bytes binary>\n", body.size);
+    sink_text(&app->sink, iov, 1);
+    break;
+  default:
+    iov[0].iov_base = "<body not inspected>\n";
+    iov[0].iov_len = strlen(iov[0].iov_base);
+    sink_text(&app->sink, iov, 1);
+    break;
+  }
+}
+
+/* Replays every record of a segment, returns 0 on success */
+static int replay_segment(app_data_t *app, const char *path) {
+  struct stat st;
+  if (stat(path, &st) == 0 && st.st_size == 0) {
+    return 0;  /* a segment closed before any message was journaled */
+  }
+  mapped_file_t file;
+  if (mapped_file_open(&file, path) != 0) {
+    return 1;
+  }
+  size_t offset = 0, released = 0;
+  pn_bytes_t record;
+  int rc;
+  while ((rc = journal_next(file.bytes, &offset, &record)) > 0) {
+    output_message(app, record);
+    app->messages++;
+    app->bytes += record.size;
+    if (offset - released >= REPLAY_RELEASE_STEP) {
+      mapped_file_release(&file, released, offset - released);
+      released = offset;
+    }
+  }
+  if (rc < 0) {
+    fprintf(stderr, "%s: truncated record at offset %zu\n", path, offset);
+  }
+  mapped_file_close(&file);
+  return rc < 0 ? 1 : 0;
+}
+
+void usage() {
+    printf("Usage: journal_replay [options] <segment>...\n");
+    printf("[Options]:\n");
+    printf("\t-o      Message output: print, quiet (count only), text (batched writes) or dump:<file> (length prefixed binary) [print]\n");
+    printf("\t-h      Displays this message\n");
+    exit(0);
+
+}
+
+void parse_args(int argc, char **argv, app_data_t *app) {
+    char c;
+    /* initialize default values*/
+    app->output = "print";
+
+    /* command line options */
+    opterr = 0;
+    while((c = getopt(argc, argv, "o:h")) != -1) {
+        switch(c) {
+        case 'h': usage(); break;
+        case 'o': app->output = optarg; break;
+        default: usage(); break;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "No journal segments given\n");
+        usage();
+    }
+
+}
+
+int main(int argc, char **argv) {
+    struct app_data_t app = {0};
+    int exit_code = 0;
+
+    parse_args(argc, argv, &app);
+    if (sink_open(&app.sink, app.output) != 0) {
+        fprintf(stderr, "Invalid message output: %s\n", app.output);
+        usage();
+    }
+    /* nothing waits on the replay, let it run at the writer's pace rather than drop records */
+    sink_set_blocking(&app.sink, true);
+    const uint64_t start = monotonic_time_ns();
+    /* segments in the order given, the shell sorts <path>.* by index */
+    for (int i = optind; i < argc; i++) {
+        if (replay_segment(&app, argv[i]) != 0) {
+            exit_code = 1;
+        }
+    }
+    const double seconds = (monotonic_time_ns() - start) / 1e9;
+    sink_close(&app.sink);
+    if (sink_failed(&app.sink)) {
+        exit_code = 1;
+    }
+    fprintf(stdout, "%llu messages, %llu bytes replayed in %.3f s (%.0f msg/s, %.1f MB/s)\n",
+            (unsigned long long)app.messages, (unsigned long long)app.bytes, seconds,
+            seconds > 0 ? app.messages / seconds : 0.0, seconds > 0 ? app.bytes / seconds / 1e6 : 0.0);
+    sink_print(&app.sink, stdout);
+    return exit_code;
+}
@@ -0,0 +1,187 @@
+
+#include "link_cache.h"
+#include "util.h"
+
+#include <proton/connection.h>
+#include <proton/link.h>
+#include <proton/session.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINK_QUEUE_INITIAL_CAPACITY 8
+
+int link_cache_init(link_cache_t *cache, const size_t max_links, const int session_count, const bool presettled) {
+    /* about two buckets per link, links attached over the cap only lengthen the chains */
+    size_t buckets = 16;
+    while (buckets < max_links * 2) {
+        buckets *= 2;
+    }
+    if (lru_table_init(&cache->table, buckets) != 0) {
+        return -1;
+    }
+    cache->max_links = max_links;
+    cache->presettled = presettled;
+    cache->sessions = NULL;
+    cache->session_count = session_count;
+    cache->next_session = 0;
+    cache->attached = 0;
+    cache->queued = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    cache->overflows = 0;
+    cache->waits = 0;
+    return 0;
+}
+
+void link_cache_reset(link_cache_t *cache) {
+    lru_node_t *node = cache->table.newest;
+    while (node) {
+        lru_node_t *older = node->older;
+        free(((link_entry_t*)node)->queue);
+        free(node);
+        node = older;
+    }
+    lru_table_clear(&cache->table);
+    free(cache->sessions);
+    cache->sessions = NULL;
+    cache->queued = 0;
+}
+
+void link_cache_free(link_cache_t *cache) {
+    link_cache_reset(cache);
+    lru_table_free(&cache->table);
+}
+
+int link_cache_open(link_cache_t *cache, pn_connection_t *connection) {
+    link_cache_reset(cache);
+    cache->sessions = (pn_session_t**)calloc(cache->session_count, sizeof(pn_session_t*));
+    if (!cache->sessions) {
+        return -1;
+    }
+    for (int i = 0; i < cache->session_count; i++) {
+        cache->sessions[i] = pn_session(connection);
+        pn_session_open(cache->sessions[i]);
+    }
+    cache->next_session = 0;
+    return 0;
+}
+
+static bool is_idle(const link_entry_t *entry) {
+    return entry->queued == 0 && pn_link_unsettled(entry->link) == 0;
+}
+
+/* Closes the least recently used idle link, returns false if every link is busy */
+static bool evict_idle(link_cache_t *cache) {
+    lru_node_t *node = cache->table.oldest;
+    while (node && !is_idle((link_entry_t*)node)) {
+        node = node->newer;
+    }
+    if (!node) {
+        return false;
+    }
+    link_entry_t *entry = (link_entry_t*)node;
+    lru_table_remove(&cache->table, node);
+    cache->evictions++;
+    /* events still due for the link find no entry, the detach reply frees it */
+    pn_link_set_context(entry->link, NULL);
+    pn_link_close(entry->link);
+    free(entry->queue);
+    free(entry);
+    return true;
+}
+
+link_entry_t *link_cache_get(link_cache_t *cache, const char *address, const size_t address_len) {
+    if (!cache->sessions) {
+        return NULL;
+    }
+    const uint64_t hash = hash_bytes(address, address_len);
+    for (lru_node_t *node = lru_table_chain(&cache->table, hash); node; node = node->next) {
+        link_entry_t *entry = (link_entry_t*)node;
+        if (node->hash == hash && entry->address_len == address_len
+            && memcmp(entry->address, address, address_len) == 0) {
+            cache->hits++;
+            lru_table_touch(&cache->table, node);
+            return entry;
+        }
+    }
+    cache->misses++;
+    if (cache->table.count >= cache->max_links && !evict_idle(cache)) {
+        cache->overflows++;
+    }
+    link_entry_t *entry = (link_entry_t*)malloc(sizeof(link_entry_t) + address_len + 1);
+    if (!entry) {
+        return NULL;
+    }
+    memcpy(entry->address, address, address_len);
+    entry->address[address_len] = '\0';
+    entry->address_len = address_len;
+    entry->queue = NULL;
+    entry->head = 0;
+    entry->queued = 0;
+    entry->capacity = 0;
+
+    /* link names must be unique on the connection, a closing link may still hold an old one */
+    char name[32];
+    snprintf(name, sizeof(name), "my_sender-%llu", (unsigned long long)cache->attached++);
+    pn_session_t *session = cache->sessions[cache->next_session];
+    cache->next_session = (cache->next_session + 1) % cache->session_count;
+    entry->link = pn_sender(session, name);
+    pn_terminus_set_address(pn_link_target(entry->link), entry->address);
+    if (cache->presettled) {
+        pn_link_set_snd_settle_mode(entry->link, PN_SND_SETTLED);
+    }
+    pn_link_set_context(entry->link, entry);
+    pn_link_open(entry->link);
+
+    lru_table_insert(&cache->table, &entry->node, hash);
+    return entry;
+}
+
+int link_cache_push(link_cache_t *cache, link_entry_t *entry, const link_message_t message) {
+    if (entry->queued == entry->capacity) {
+        size_t capacity = entry->capacity ? entry->capacity * 2 : LINK_QUEUE_INITIAL_CAPACITY;
+        link_message_t *queue = (link_message_t*)malloc(capacity * sizeof(link_message_t));
+        if (!queue) {
+            return -1;
+        }
+        /* unwrap the ring into the new buffer */
+        for (size_t i = 0; i < entry->queued; i++) {
+            queue[i] = entry->queue[(entry->head + i) % entry->capacity];
+        }
+        free(entry->queue);
+        entry->queue = queue;
+        entry->head = 0;
+        entry->capacity = capacity;
+    }
+    if (entry->queued > 0 || pn_link_credit(entry->link) <= 0) {
+        cache->waits++;
+    }
+    entry->queue[(entry->head + entry->queued) % entry->capacity] = message;
+    entry->queued++;
+    cache->queued++;
+    return 0;
+}
+
+bool link_cache_pop(link_cache_t *cache, link_entry_t *entry, link_message_t *message) {
+    if (entry->queued == 0) {
+        return false;
+    }
+    *message = entry->queue[entry->head];
+    entry->head = (entry->head + 1) % entry->capacity;
+    entry->queued--;
+    cache->queued--;
+    return true;
+}
+
+void link_cache_print(const link_cache_t *cache, FILE *out) {
+    fprintf(out, "link cache: %llu hits, %llu misses, %llu evictions, %llu over the cap of %zu links, "
+            "%llu messages waited for an attach or credit, %zu links open over %d sessions\n",
+            (unsigned long long)cache->hits, (unsigned long long)cache->misses,
+            (unsigned long long)cache->evictions, (unsigned long long)cache->overflows, cache->max_links,
+            (unsigned long long)cache->waits, cache->table.count, cache->session_count);
+}
@@ -0,0 +1,133 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+
+#ifndef LINK_CACHE_H
+#define LINK_CACHE_H 1
+
+
+#include "lru_table.h"
+
+#include <proton/connection.h>
+#include <proton/link.h>
+#include <proton/session.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/*
+ * Sender links to many topics without a link attach per message.
+ *
+ * Links are keyed by their prefixed target address and attached on the
+ * first message to an address, spread round robin over a few sessions.
+ * Entries are chained in a hash table and on a least recently used list;
+ * once the cache holds max_links the least recently used idle link is
+ * closed before another is attached. A link is idle when it has no queued
+ * messages and no unsettled deliveries, so an eviction never loses one.
+ * When every link is busy the new link is attached over the cap.
+ *
+ * Messages are queued on their link until it is attached and has credit.
+ * */
+typedef struct link_message_t {
+  int tag;                       /* delivery tag */
+  bool resend;                   /* sent before on a connection that dropped */
+} link_message_t;
+
+typedef struct link_entry_t {
+  lru_node_t node;               /* first, the hash chain and LRU list */
+  pn_link_t *link;
+  link_message_t *queue;         /* ring of messages waiting for the attach or credit */
+  size_t head;
+  size_t queued;
+  size_t capacity;
+  size_t address_len;
+  char address[];                /* the target address, nul terminated */
+} link_entry_t;
+
+typedef struct link_cache_t {
+  lru_table_t table;
+  size_t max_links;
+  bool presettled;               /* links attach with the settled sender mode */
+  pn_session_t **sessions;       /* NULL while there is no connection */
+  int session_count;
+  int next_session;
+  uint64_t attached;             /* links attached, numbers the link names */
+  size_t queued;                 /* messages queued on all links */
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t overflows;            /* links attached over the cap, every link was busy */
+  uint64_t waits;                /* messages queued behind an attach or missing credit */
+} link_cache_t;
+
+/*
+ * @param[in]: max_links, links kept attached before idle ones are closed
+ * @param[in]: session_count, sessions the links are spread over
+ * @param[in]: presettled, attach the links with the settled sender mode
+ *
+ * @returns: 0 on success, -1 if allocation failed
+ * */
+int link_cache_init(link_cache_t *cache, const size_t max_links, const int session_count, const bool presettled);
+
+void link_cache_free(link_cache_t *cache);
+
+/*
+ * Opens the sessions of a new connection, links attach on them from
+ * the next lookup.
+ *
+ * @returns: 0 on success, -1 if allocation failed
+ * */
+int link_cache_open(link_cache_t *cache, pn_connection_t *connection);
+
+/*
+ * Forgets every link and queued message once the connection is closed,
+ * proton frees the links with it.
+ * */
+void link_cache_reset(link_cache_t *cache);
+
+/*
+ * Returns the entry of the target address, attaching its link on a miss.
+ * The link context is the entry until the link is evicted.
+ *
+ * @returns: the entry, NULL if the cache is not open or allocation failed
+ * */
+link_entry_t *link_cache_get(link_cache_t *cache, const char *address, const size_t address_len);
+
+/*
+ * Queues a message to send once the link has credit.
+ *
+ * @returns: 0 on success, -1 if allocation failed
+ * */
+int link_cache_push(link_cache_t *cache, link_entry_t *entry, const link_message_t message);
+
+/*
+ * Takes the oldest queued message of the link.
+ *
+ * @returns: true if a message was queued
+ * */
+bool link_cache_pop(link_cache_t *cache, link_entry_t *entry, link_message_t *message);
+
+void link_cache_print(const link_cache_t *cache, FILE *out);
+
+#endif /* link_cache.h */
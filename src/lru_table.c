@@ -0,0 +1,102 @@
+
+#include "lru_table.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+int lru_table_init(lru_table_t *table, const size_t buckets) {
+    size_t size = 1;
+    while (size < buckets) {
+        size *= 2;
+    }
+    table->buckets = (lru_node_t**)calloc(size, sizeof(lru_node_t*));
+    if (!table->buckets) {
+        return -1;
+    }
+    table->mask = size - 1;
+    table->newest = NULL;
+    table->oldest = NULL;
+    table->count = 0;
+    return 0;
+}
+
+void lru_table_free(lru_table_t *table) {
+    free(table->buckets);
+    table->buckets = NULL;
+    table->newest = NULL;
+    table->oldest = NULL;
+    table->count = 0;
+}
+
+void lru_table_clear(lru_table_t *table) {
+    if (table->buckets) {
+        memset(table->buckets, 0, (table->mask + 1) * sizeof(lru_node_t*));
+    }
+    table->newest = NULL;
+    table->oldest = NULL;
+    table->count = 0;
+}
+
+lru_node_t *lru_table_chain(const lru_table_t *table, const uint64_t hash) {
+    return table->buckets[hash & table->mask];
+}
+
+static void lru_unlink(lru_table_t *table, lru_node_t *node) {
+    if (node->newer) node->newer->older = node->older; else table->newest = node->older;
+    if (node->older) node->older->newer = node->newer; else table->oldest = node->newer;
+}
+
+static void lru_push(lru_table_t *table, lru_node_t *node) {
+    node->newer = NULL;
+    node->older = table->newest;
+    if (table->newest) table->newest->newer = node; else table->oldest = node;
+    table->newest = node;
+}
+
+void lru_table_insert(lru_table_t *table, lru_node_t *node, const uint64_t hash) {
+    node->hash = hash;
+    node->next = table->buckets[hash & table->mask];
+    table->buckets[hash & table->mask] = node;
+    lru_push(table, node);
+    table->count++;
+}
+
+void lru_table_remove(lru_table_t *table, lru_node_t *node) {
+    lru_node_t **link = &table->buckets[node->hash & table->mask];
+    while (*link != node) {
+        link = &(*link)->next;
+    }
+    *link = node->next;
+    lru_unlink(table, node);
+    table->count--;
+}
+
+void lru_table_touch(lru_table_t *table, lru_node_t *node) {
+    if (node != table->newest) {
+        lru_unlink(table, node);
+        lru_push(table, node);
+    }
+}
+
+bool lru_table_grow(lru_table_t *table) {
+    const size_t size = (table->mask + 1) * 2;
+    lru_node_t **buckets = (lru_node_t**)calloc(size, sizeof(lru_node_t*));
+    if (!buckets) {
+        return false;
+    }
+    for (size_t i = 0; i <= table->mask; i++) {
+        lru_node_t *node = table->buckets[i];
+        while (node) {
+            lru_node_t *next = node->next;
+            node->next = buckets[node->hash & (size - 1)];
+            buckets[node->hash & (size - 1)] = node;
+            node = next;
+        }
+    }
+    free(table->buckets);
+    table->buckets = buckets;
+    table->mask = size - 1;
+    return true;
+}
@@ -0,0 +1,100 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+
+#ifndef LRU_TABLE_H
+#define LRU_TABLE_H 1
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/*
+ * Hash chains and a least recently used list over caller owned entries.
+ *
+ * An entry embeds an lru_node_t as its first member, the table links and
+ * unlinks the nodes but never allocates or frees an entry. Callers hash
+ * their keys, walk the chain of a hash comparing keys themselves and pick
+ * what to evict from the oldest end of the list.
+ * */
+typedef struct lru_node_t {
+  struct lru_node_t *next;       /* hash chain */
+  struct lru_node_t *newer;      /* LRU list */
+  struct lru_node_t *older;
+  uint64_t hash;
+} lru_node_t;
+
+typedef struct lru_table_t {
+  lru_node_t **buckets;
+  size_t mask;                   /* bucket count - 1 */
+  lru_node_t *newest;            /* most recently used */
+  lru_node_t *oldest;            /* evicted first */
+  size_t count;
+} lru_table_t;
+
+/*
+ * @param[in]: buckets, initial bucket count, rounded up to a power of two
+ *
+ * @returns: 0 on success, -1 if allocation failed
+ * */
+int lru_table_init(lru_table_t *table, const size_t buckets);
+
+/*
+ * Frees the buckets, the entries are the caller's to free first.
+ * */
+void lru_table_free(lru_table_t *table);
+
+/*
+ * Forgets every entry, the caller frees them before or after.
+ * */
+void lru_table_clear(lru_table_t *table);
+
+/*
+ * Returns the first node of the chain holding hash, follow node->next and
+ * compare node->hash before the keys.
+ * */
+lru_node_t *lru_table_chain(const lru_table_t *table, const uint64_t hash);
+
+/*
+ * Adds an entry as the most recently used.
+ * */
+void lru_table_insert(lru_table_t *table, lru_node_t *node, const uint64_t hash);
+
+/*
+ * Takes an entry out of its chain and the list, the caller frees it.
+ * */
+void lru_table_remove(lru_table_t *table, lru_node_t *node);
+
+/*
+ * Marks an entry as the most recently used.
+ * */
+void lru_table_touch(lru_table_t *table, lru_node_t *node);
+
+/*
+ * Doubles the buckets, keeping the longer chains if allocation fails.
+ *
+ * @returns: true if the buckets grew
+ * */
+bool lru_table_grow(lru_table_t *table);
+
+#endif /* lru_table.h */
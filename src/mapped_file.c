@@ -0,0 +1,52 @@
+
+#include "mapped_file.h"
+
+#include <proton/types.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int mapped_file_open(mapped_file_t *file, const char *path) {
+    file->fd = open(path, O_RDONLY);
+    if (file->fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(file->fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "Unable to map empty or unreadable file: %s\n", path);
+        close(file->fd);
+        return -1;
+    }
+    void *start = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+    if (start == MAP_FAILED) {
+        perror(path);
+        close(file->fd);
+        return -1;
+    }
+    madvise(start, st.st_size, MADV_SEQUENTIAL);
+    file->bytes = pn_bytes(st.st_size, (const char*)start);
+    return 0;
+}
+
+void mapped_file_release(mapped_file_t *file, const size_t offset, const size_t size) {
+    /* madvise needs a page aligned start, only drop whole consumed pages */
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t start = (offset + page - 1) / page * page;
+    const size_t end = (offset + size) / page * page;
+    if (end > start) {
+        madvise((void*)(file->bytes.start + start), end - start, MADV_DONTNEED);
+    }
+}
+
+void mapped_file_close(mapped_file_t *file) {
+    if (file->bytes.start) {
+        munmap((void*)file->bytes.start, file->bytes.size);
+        close(file->fd);
+        file->bytes = pn_bytes_null;
+    }
+}
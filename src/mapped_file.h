@@ -0,0 +1,61 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H 1
+
+
+#include <proton/types.h>
+
+#include <stdlib.h>
+
+
+/*
+ * A read only memory mapped file.
+ * */
+typedef struct mapped_file_t {
+  int fd;
+  pn_bytes_t bytes;   /* the mapped file contents */
+} mapped_file_t;
+
+/*
+ * Maps a whole file read only for sequential access.
+ *
+ * @param[out]: file, the mapping
+ * @param[in]: path, the file to map
+ *
+ * @returns: 0 on success, -1 if the file cannot be opened or mapped
+ * */
+int mapped_file_open(mapped_file_t *file, const char *path);
+
+/*
+ * Drops the pages of [offset, offset + size) from the process resident set
+ * once they have been consumed. The contents stay valid and are read back
+ * from the page cache if touched again.
+ * */
+void mapped_file_release(mapped_file_t *file, const size_t offset, const size_t size);
+
+/*
+ * Unmaps and closes the file.
+ * */
+void mapped_file_close(mapped_file_t *file);
+
+#endif /* mapped_file.h */
@@ -0,0 +1,279 @@
+
+#include "msg_template.h"
+#include "msg_view.h"
+
+#include <proton/codec.h>
+#include <proton/error.h>
+#include <proton/message.h>
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+/* AMQP 1.0 amqp-value section descriptor: 0x00 smallulong 0x77 */
+static const char AMQP_VALUE_DESCRIPTOR[] = { 0x00, 0x53, 0x77 };
+
+/* AMQP 1.0 data section descriptor: 0x00 smallulong 0x75 */
+static const char AMQP_DATA_DESCRIPTOR[] = { 0x00, 0x53, 0x75 };
+
+/* AMQP 1.0 properties section descriptor: 0x00 smallulong 0x73 */
+static const char AMQP_PROPERTIES_DESCRIPTOR[] = { 0x00, 0x53, 0x73 };
+
+#define AMQP_STR8_UTF8 ((char)0xa1)
+
+#define AMQP_STR32_UTF8 ((char)0xb1)
+
+#define AMQP_VBIN32 ((char)0xb0)
+
+#define AMQP_ULONG ((char)0x80)
+
+#define AMQP_NULL ((char)0x40)
+
+#define AMQP_LIST8 ((char)0xc0)
+
+#define AMQP_LIST32 ((char)0xd0)
+
+/* room for the digits of any int plus the terminating nul written by snprintf */
+#define SEQUENCE_DIGITS_MAX 12
+
+/*
+ * Encodes the message sections ahead of the body into a buffer with
+ * 'extra' spare bytes at the end. The encoded size is returned in 'encoded'.
+ * */
+static int encode_sections(pn_message_t *message, const size_t extra, char **out, size_t *encoded) {
+    /* encode header and properties sections, expanding the buffer as needed */
+    size_t size = 128;
+    char *buf = (char*)malloc(size);
+    *encoded = size;
+    int status = 0;
+    while ((status = pn_message_encode(message, buf, encoded)) == PN_OVERFLOW) {
+        size *= 2;
+        buf = (char*)realloc(buf, size);
+        *encoded = size;
+    }
+    if (status != 0) {
+        free(buf);
+        return status;
+    }
+    *out = (char*)realloc(buf, *encoded + extra);
+    return 0;
+}
+
+/*
+ * Encodes the prototype message once, then appends an amqp-value section
+ * holding a str8 string. The str8 encoding keeps the string length in a
+ * single byte in front of the text so it can be patched per message.
+ * */
+int msg_template_init(msg_template_t *tmpl, pn_message_t *message, const char *body_prefix) {
+    if (!tmpl || !message || !body_prefix) {
+        return PN_ARG_ERR;
+    }
+    const size_t body_prefix_len = strlen(body_prefix);
+    if (body_prefix_len + SEQUENCE_DIGITS_MAX > 0xff) {
+        /* body text must fit a str8 encoding */
+        return PN_ARG_ERR;
+    }
+    /* make room for the hand encoded body section */
+    const size_t extra = sizeof(AMQP_VALUE_DESCRIPTOR) + 2 + body_prefix_len + SEQUENCE_DIGITS_MAX;
+    char *buf = NULL;
+    size_t encoded = 0;
+    int status = encode_sections(message, extra, &buf, &encoded);
+    if (status != 0) {
+        return status;
+    }
+    const size_t size = encoded + extra;
+
+    char *p = buf + encoded;
+    memcpy(p, AMQP_VALUE_DESCRIPTOR, sizeof(AMQP_VALUE_DESCRIPTOR));
+    p += sizeof(AMQP_VALUE_DESCRIPTOR);
+    *p++ = AMQP_STR8_UTF8;
+    tmpl->text_offset = p - buf;
+    *p++ = (char)body_prefix_len;
+    memcpy(p, body_prefix, body_prefix_len);
+    p += body_prefix_len;
+    tmpl->digit_offset = p - buf;
+    tmpl->length_offset = 0;
+    tmpl->sections_size = encoded;
+    tmpl->buffer = pn_rwbytes(size, buf);
+    return 0;
+}
+
+int msg_template_init_payload(msg_template_t *tmpl, pn_message_t *message, const bool binary) {
+    if (!tmpl || !message) {
+        return PN_ARG_ERR;
+    }
+    /* descriptor, constructor and 32 bit length, the body follows separately */
+    const size_t extra = sizeof(AMQP_DATA_DESCRIPTOR) + 1 + 4;
+    char *buf = NULL;
+    size_t encoded = 0;
+    int status = encode_sections(message, extra, &buf, &encoded);
+    if (status != 0) {
+        return status;
+    }
+    char *p = buf + encoded;
+    if (binary) {
+        memcpy(p, AMQP_DATA_DESCRIPTOR, sizeof(AMQP_DATA_DESCRIPTOR));
+        p += sizeof(AMQP_DATA_DESCRIPTOR);
+        *p++ = AMQP_VBIN32;
+    } else {
+        memcpy(p, AMQP_VALUE_DESCRIPTOR, sizeof(AMQP_VALUE_DESCRIPTOR));
+        p += sizeof(AMQP_VALUE_DESCRIPTOR);
+        *p++ = AMQP_STR32_UTF8;
+    }
+    tmpl->length_offset = p - buf;
+    tmpl->text_offset = 0;
+    tmpl->digit_offset = 0;
+    tmpl->sections_size = encoded;
+    tmpl->buffer = pn_rwbytes(encoded + extra, buf);
+    return 0;
+}
+
+pn_bytes_t msg_template_encode_payload(msg_template_t *tmpl, const size_t body_size) {
+    unsigned char *len = (unsigned char*)tmpl->buffer.start + tmpl->length_offset;
+    /* AMQP lengths are big endian */
+    len[0] = (unsigned char)(body_size >> 24);
+    len[1] = (unsigned char)(body_size >> 16);
+    len[2] = (unsigned char)(body_size >> 8);
+    len[3] = (unsigned char)body_size;
+    return pn_bytes(tmpl->length_offset + 4, tmpl->buffer.start);
+}
+
+pn_bytes_t msg_template_encode(msg_template_t *tmpl, int sequence) {
+    char *buf = tmpl->buffer.start;
+    int digits = snprintf(buf + tmpl->digit_offset, SEQUENCE_DIGITS_MAX, "%d", sequence);
+    /* patch the str8 length: body prefix plus the new digits */
+    buf[tmpl->text_offset] = (char)(tmpl->digit_offset - tmpl->text_offset - 1 + digits);
+    return pn_bytes(tmpl->digit_offset + digits, buf);
+}
+
+/* AMQP numbers are big endian */
+static void write_ulong(unsigned char *p, uint64_t value) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (unsigned char)value;
+        value >>= 8;
+    }
+}
+
+int msg_template_find_ulong(const msg_template_t *tmpl, const uint64_t placeholder, size_t *offset) {
+    unsigned char encoded[9];
+    encoded[0] = (unsigned char)AMQP_ULONG;
+    write_ulong(encoded + 1, placeholder);
+    const char *buf = tmpl->buffer.start;
+    /* the placeholders are in the sections, the body bytes after them are not written yet */
+    for (size_t i = 0; i + sizeof(encoded) <= tmpl->sections_size; i++) {
+        if (memcmp(buf + i, encoded, sizeof(encoded)) == 0) {
+            *offset = i + 1;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void msg_template_patch_ulong(msg_template_t *tmpl, const size_t offset, const uint64_t value) {
+    write_ulong((unsigned char*)tmpl->buffer.start + offset, value);
+}
+
+static void write_uint(unsigned char *p, const uint32_t value) {
+    p[0] = (unsigned char)(value >> 24);
+    p[1] = (unsigned char)(value >> 16);
+    p[2] = (unsigned char)(value >> 8);
+    p[3] = (unsigned char)value;
+}
+
+int msg_template_find_properties(msg_template_t *tmpl) {
+    msg_view_t view;
+    if (msg_view_parse(&view, pn_bytes(tmpl->sections_size, tmpl->buffer.start)) != 0) {
+        return -1;
+    }
+    tmpl->message_id = pn_bytes_null;
+    tmpl->user_id = pn_bytes_null;
+    tmpl->properties_rest = pn_bytes_null;
+    tmpl->properties_rest_count = 0;
+    const size_t descriptor = sizeof(AMQP_PROPERTIES_DESCRIPTOR);
+    if (view.properties.size == 0) {
+        /* no properties section, it goes ahead of the application properties or the body */
+        tmpl->properties_offset = view.application_properties.size > 0
+            ? (size_t)(view.application_properties.start - tmpl->buffer.start) - descriptor
+            : tmpl->sections_size;
+        tmpl->properties_end = tmpl->properties_offset;
+        return 0;
+    }
+    const size_t offset = (size_t)(view.properties.start - tmpl->buffer.start);
+    if (offset < descriptor
+        || memcmp(view.properties.start - descriptor, AMQP_PROPERTIES_DESCRIPTOR, descriptor) != 0) {
+        return -1; /* proton writes the small descriptor */
+    }
+    tmpl->properties_offset = offset - descriptor;
+    tmpl->properties_end = offset + view.properties.size;
+    msg_view_list_get(view.properties, MSG_VIEW_MESSAGE_ID, &tmpl->message_id);
+    msg_view_list_get(view.properties, MSG_VIEW_MESSAGE_ID + 1, &tmpl->user_id);
+    pn_bytes_t field;
+    for (size_t i = MSG_VIEW_TO + 1; msg_view_list_get(view.properties, i, &field) == 0; i++) {
+        if (tmpl->properties_rest_count++ == 0) {
+            tmpl->properties_rest.start = field.start;
+        }
+        tmpl->properties_rest.size = (size_t)(field.start + field.size - tmpl->properties_rest.start);
+    }
+    return 0;
+}
+
+size_t msg_template_encode_to(const msg_template_t *tmpl, char *buf, const size_t size,
+                              const char *address, const size_t address_len) {
+    /* the prototype message-id and user-id or nulls, the to string, then the prototype fields after it */
+    const size_t to_size = (address_len <= 0xff ? 2 : 5) + address_len;
+    const size_t fields = (tmpl->message_id.size ? tmpl->message_id.size : 1)
+        + (tmpl->user_id.size ? tmpl->user_id.size : 1) + to_size + tmpl->properties_rest.size;
+    const size_t count = 3 + tmpl->properties_rest_count;
+    const bool small = 1 + fields <= 0xff && count <= 0xff;
+    const size_t encoded = sizeof(AMQP_PROPERTIES_DESCRIPTOR) + (small ? 3 : 9) + fields;
+    if (encoded > size) {
+        return 0;
+    }
+    unsigned char *p = (unsigned char*)buf;
+    memcpy(p, AMQP_PROPERTIES_DESCRIPTOR, sizeof(AMQP_PROPERTIES_DESCRIPTOR));
+    p += sizeof(AMQP_PROPERTIES_DESCRIPTOR);
+    if (small) {
+        /* the list size counts the count byte and the fields */
+        *p++ = (unsigned char)AMQP_LIST8;
+        *p++ = (unsigned char)(1 + fields);
+        *p++ = (unsigned char)count;
+    } else {
+        *p++ = (unsigned char)AMQP_LIST32;
+        write_uint(p, (uint32_t)(4 + fields));
+        write_uint(p + 4, (uint32_t)count);
+        p += 8;
+    }
+    if (tmpl->message_id.size) {
+        memcpy(p, tmpl->message_id.start, tmpl->message_id.size);
+        p += tmpl->message_id.size;
+    } else {
+        *p++ = (unsigned char)AMQP_NULL;
+    }
+    if (tmpl->user_id.size) {
+        memcpy(p, tmpl->user_id.start, tmpl->user_id.size);
+        p += tmpl->user_id.size;
+    } else {
+        *p++ = (unsigned char)AMQP_NULL;
+    }
+    if (address_len <= 0xff) {
+        *p++ = (unsigned char)AMQP_STR8_UTF8;
+        *p++ = (unsigned char)address_len;
+    } else {
+        *p++ = (unsigned char)AMQP_STR32_UTF8;
+        write_uint(p, (uint32_t)address_len);
+        p += 4;
+    }
+    memcpy(p, address, address_len);
+    p += address_len;
+    if (tmpl->properties_rest.size) {
+        memcpy(p, tmpl->properties_rest.start, tmpl->properties_rest.size);
+    }
+    return encoded;
+}
+
+void msg_template_free(msg_template_t *tmpl) {
+    if (tmpl) {
+        free(tmpl->buffer.start);
+        tmpl->buffer = pn_rwbytes_null;
+    }
+}
@@ -0,0 +1,157 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifndef MSG_TEMPLATE_H
+#define MSG_TEMPLATE_H 1
+
+
+#include <proton/codec.h>
+#include <proton/message.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/*
+ * A pre-encoded AMQP message used to send many messages that only
+ * differ by a sequence number.
+ *
+ * The header and properties sections are encoded once from a prototype
+ * pn_message_t. The amqp-value body section is written by hand after them
+ * as '<body_prefix><sequence>', so each message only patches the sequence
+ * digits and the body string length in place.
+ *
+ * In payload mode the template ends with the body section header and the
+ * body bytes are sent separately, only the 32 bit body length is patched.
+ * */
+typedef struct msg_template_t {
+  pn_rwbytes_t buffer;  /* encoded sections, reused for every message */
+  size_t text_offset;   /* offset of the body string length byte */
+  size_t digit_offset;  /* offset where the sequence digits are written */
+  size_t length_offset; /* offset of the 32 bit body length in payload mode */
+  size_t sections_size; /* bytes of the sections encoded from the prototype, the body follows */
+  size_t properties_offset; /* span of the properties section, empty where it belongs if absent */
+  size_t properties_end;
+  pn_bytes_t message_id; /* prototype properties fields kept when the to address is replaced */
+  pn_bytes_t user_id;
+  pn_bytes_t properties_rest; /* the fields after to */
+  size_t properties_rest_count;
+} msg_template_t;
+
+/*
+ * Encodes the prototype message sections into the template buffer.
+ * The prototype body must be empty, the template supplies the body.
+ *
+ * @param[out]: tmpl, the template to initialize
+ * @param[in]: message, the prototype message with header and properties set
+ * @param[in]: body_prefix, the fixed text ahead of the sequence number, eg. 'sequence_'
+ *
+ * @returns: 0 on success or a negative proton error code
+ * */
+int msg_template_init(msg_template_t *tmpl, pn_message_t *message, const char *body_prefix);
+
+/*
+ * Patches the sequence number into the template body.
+ * Does not allocate, the returned bytes point into the template buffer
+ * and are only valid until the next call.
+ *
+ * @param[in]: tmpl, an initialized template
+ * @param[in]: sequence, the number appended to the body prefix
+ *
+ * @returns: the encoded message
+ * */
+pn_bytes_t msg_template_encode(msg_template_t *tmpl, int sequence);
+
+/*
+ * Encodes the prototype message sections followed by the header of a body
+ * section whose bytes are sent separately: a data section holding vbin32
+ * for binary bodies, or an amqp-value section holding str32 otherwise.
+ *
+ * @param[out]: tmpl, the template to initialize
+ * @param[in]: message, the prototype message with header and properties set
+ * @param[in]: binary, true for a data section body
+ *
+ * @returns: 0 on success or a negative proton error code
+ * */
+int msg_template_init_payload(msg_template_t *tmpl, pn_message_t *message, const bool binary);
+
+/*
+ * Patches the body length into a payload mode template.
+ * The message is the returned bytes followed by body_size body bytes.
+ *
+ * @param[in]: tmpl, a template initialized with msg_template_init_payload
+ * @param[in]: body_size, the number of body bytes sent after the template
+ *
+ * @returns: the encoded message up to the body bytes
+ * */
+pn_bytes_t msg_template_encode_payload(msg_template_t *tmpl, const size_t body_size);
+
+/*
+ * Finds where a ulong placeholder value was encoded in the template, so it
+ * can be patched per message with msg_template_patch_ulong. The placeholder
+ * must be above 0xff so it is encoded as an 8 byte ulong. Only the sections
+ * encoded from the prototype are searched, not the body bytes after them.
+ *
+ * @param[in]: tmpl, an initialized template
+ * @param[in]: placeholder, the value set in the prototype message
+ * @param[out]: offset, the offset of the 8 value bytes in the template
+ *
+ * @returns: 0 on success, -1 if the placeholder was not found
+ * */
+int msg_template_find_ulong(const msg_template_t *tmpl, const uint64_t placeholder, size_t *offset);
+
+/*
+ * Writes a ulong value at an offset found with msg_template_find_ulong.
+ * */
+void msg_template_patch_ulong(msg_template_t *tmpl, const size_t offset, const uint64_t value);
+
+/*
+ * Locates the properties section of the template, so a properties section
+ * holding a per message to address can be sent in its place between the
+ * template bytes before properties_offset and from properties_end on.
+ * If the prototype has no properties section the span is empty, at the
+ * offset the section belongs.
+ *
+ * @returns: 0 on success, -1 if the template sections are malformed
+ * */
+int msg_template_find_properties(msg_template_t *tmpl);
+
+/*
+ * Writes the prototype properties section with its to field replaced,
+ * the other fields are copied as encoded.
+ *
+ * @param[in]: tmpl, a template after msg_template_find_properties
+ * @param[out]: buf, where the section is written
+ * @param[in]: size, the buffer size
+ * @param[in]: address, the to address
+ *
+ * @returns: the encoded size, 0 if it does not fit the buffer
+ * */
+size_t msg_template_encode_to(const msg_template_t *tmpl, char *buf, const size_t size,
+                              const char *address, const size_t address_len);
+
+/*
+ * Frees the template buffer.
+ * */
+void msg_template_free(msg_template_t *tmpl);
+
+#endif /* msg_template.h */
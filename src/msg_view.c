@@ -0,0 +1,241 @@
+
+#include "msg_view.h"
+
+#include <proton/codec.h>
+#include <proton/error.h>
+#include <proton/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* AMQP numbers are big endian */
+static uint64_t read_be(const unsigned char *p, const size_t width) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < width; i++) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+/*
+ * Returns the size of the encoded value at p including its constructor,
+ * 0 if it is malformed or runs past the end. The width of a value follows
+ * from the upper nibble of its constructor, see the AMQP 1.0 type system.
+ * */
+static size_t value_size(const unsigned char *p, const size_t available) {
+    if (available == 0) {
+        return 0;
+    }
+    if (p[0] == 0x00) {
+        /* described type: descriptor value followed by the value */
+        size_t descriptor = value_size(p + 1, available - 1);
+        if (descriptor == 0) {
+            return 0;
+        }
+        size_t value = value_size(p + 1 + descriptor, available - 1 - descriptor);
+        return value == 0 ? 0 : 1 + descriptor + value;
+    }
+    size_t size = 0;
+    switch (p[0] >> 4) {
+    case 0x4: size = 1; break;
+    case 0x5: size = 2; break;
+    case 0x6: size = 3; break;
+    case 0x7: size = 5; break;
+    case 0x8: size = 9; break;
+    case 0x9: size = 17; break;
+    case 0xa: case 0xc: case 0xe:
+        /* one byte size ahead of the contents */
+        if (available < 2) return 0;
+        size = 2 + (size_t)p[1];
+        break;
+    case 0xb: case 0xd: case 0xf:
+        /* four byte size ahead of the contents */
+        if (available < 5) return 0;
+        size = 5 + (size_t)read_be(p + 1, 4);
+        break;
+    default: return 0;
+    }
+    return size <= available ? size : 0;
+}
+
+/*
+ * Locates the elements of an encoded list or map.
+ * Returns the element count and points first at the first element,
+ * -1 if the value is not a list or map of the expected kind.
+ * */
+static long compound_elements(const pn_bytes_t value, const bool map, const unsigned char **first) {
+    const unsigned char *p = (const unsigned char*)value.start;
+    if (value.size == 0) {
+        return -1;
+    }
+    if (!map && p[0] == 0x45) {
+        /* list0 */
+        return 0;
+    }
+    const unsigned char c8 = map ? 0xc1 : 0xc0;
+    const unsigned char c32 = map ? 0xd1 : 0xd0;
+    if (p[0] == c8 && value.size >= 3) {
+        *first = p + 3;
+        return p[2];
+    }
+    if (p[0] == c32 && value.size >= 9) {
+        *first = p + 9;
+        return (long)read_be(p + 5, 4);
+    }
+    return -1;
+}
+
+/* Maps a section descriptor to its code, 0 if it is not a known section */
+static uint8_t section_code(const unsigned char *p, const size_t size) {
+    static const char *names[] = {
+        "amqp:header:list", "amqp:delivery-annotations:map", "amqp:message-annotations:map",
+        "amqp:properties:list", "amqp:application-properties:map", "amqp:data:binary",
+        "amqp:amqp-sequence:list", "amqp:amqp-value:*", "amqp:footer:map"
+    };
+    uint64_t code = 0;
+    if (p[0] == 0x53 && size == 2) {
+        code = p[1];
+    } else if (p[0] == 0x80 && size == 9) {
+        code = read_be(p + 1, 8);
+    } else if (p[0] == 0xa3 && size > 2) {
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            if (strlen(names[i]) == p[1] && memcmp(p + 2, names[i], p[1]) == 0) {
+                code = MSG_VIEW_HEADER + i;
+            }
+        }
+    }
+    return code >= MSG_VIEW_HEADER && code <= MSG_VIEW_FOOTER ? (uint8_t)code : 0;
+}
+
+int msg_view_parse(msg_view_t *view, const pn_bytes_t data) {
+    memset(view, 0, sizeof(*view));
+    const unsigned char *p = (const unsigned char*)data.start;
+    size_t remaining = data.size;
+    while (remaining > 0) {
+        if (p[0] != 0x00) {
+            return PN_ERR;
+        }
+        size_t descriptor = value_size(p + 1, remaining - 1);
+        if (descriptor == 0) {
+            return PN_ERR;
+        }
+        const unsigned char *value = p + 1 + descriptor;
+        size_t size = value_size(value, remaining - 1 - descriptor);
+        if (size == 0) {
+            return PN_ERR;
+        }
+        pn_bytes_t section = pn_bytes(size, (const char*)value);
+        uint8_t code = section_code(p + 1, descriptor);
+        switch (code) {
+        case MSG_VIEW_HEADER: view->header = section; break;
+        case MSG_VIEW_MESSAGE_ANNOTATIONS: view->message_annotations = section; break;
+        case MSG_VIEW_PROPERTIES: view->properties = section; break;
+        case MSG_VIEW_APPLICATION_PROPERTIES: view->application_properties = section; break;
+        case MSG_VIEW_DATA:
+        case MSG_VIEW_AMQP_SEQUENCE:
+        case MSG_VIEW_AMQP_VALUE:
+            if (view->body_sections++ == 0) {
+                view->body = section;
+                view->body_code = code;
+            }
+            break;
+        default: break; /* delivery annotations, footer and unknown sections are skipped */
+        }
+        p += 1 + descriptor + size;
+        remaining -= 1 + descriptor + size;
+    }
+    return 0;
+}
+
+pn_type_t msg_view_body(const msg_view_t *view, pn_bytes_t *bytes) {
+    if (view->body_sections != 1 || msg_view_get_bytes(view->body, bytes) != 0) {
+        return PN_NULL;
+    }
+    switch ((unsigned char)view->body.start[0]) {
+    case 0xa0: case 0xb0: return PN_BINARY;
+    case 0xa1: case 0xb1: return PN_STRING;
+    default: return PN_SYMBOL;
+    }
+}
+
+int msg_view_list_get(const pn_bytes_t list, const size_t index, pn_bytes_t *value) {
+    const unsigned char *p = NULL;
+    long count = compound_elements(list, false, &p);
+    if (count < 0 || index >= (size_t)count) {
+        return -1;
+    }
+    const unsigned char *end = (const unsigned char*)list.start + list.size;
+    for (size_t i = 0; i <= index; i++) {
+        size_t size = value_size(p, end - p);
+        if (size == 0) {
+            return -1;
+        }
+        if (i == index) {
+            *value = pn_bytes(size, (const char*)p);
+            return 0;
+        }
+        p += size;
+    }
+    return -1;
+}
+
+int msg_view_map_get(const pn_bytes_t map, const char *key, const size_t key_len, pn_bytes_t *value) {
+    const unsigned char *p = NULL;
+    long count = compound_elements(map, true, &p);
+    if (count < 0) {
+        return -1;
+    }
+    const unsigned char *end = (const unsigned char*)map.start + map.size;
+    for (long i = 0; i + 1 < count; i += 2) {
+        size_t key_size = value_size(p, end - p);
+        if (key_size == 0) {
+            return -1;
+        }
+        size_t value_bytes = value_size(p + key_size, end - p - key_size);
+        if (value_bytes == 0) {
+            return -1;
+        }
+        pn_bytes_t name;
+        if (msg_view_get_bytes(pn_bytes(key_size, (const char*)p), &name) == 0
+            && name.size == key_len && memcmp(name.start, key, key_len) == 0) {
+            *value = pn_bytes(value_bytes, (const char*)p + key_size);
+            return 0;
+        }
+        p += key_size + value_bytes;
+    }
+    return -1;
+}
+
+int msg_view_get_ulong(const pn_bytes_t value, uint64_t *out) {
+    if (value.size == 0) {
+        return -1;
+    }
+    const unsigned char *p = (const unsigned char*)value.start;
+    switch (p[0]) {
+    case 0x43: case 0x44: *out = 0; return 0;                    /* uint0, ulong0 */
+    case 0x50: case 0x52: case 0x53: *out = p[1]; return 0;      /* ubyte, smalluint, smallulong */
+    case 0x51: case 0x54: case 0x55: *out = (uint64_t)(int64_t)(int8_t)p[1]; return 0; /* byte, smallint, smalllong */
+    case 0x60: *out = read_be(p + 1, 2); return 0;               /* ushort */
+    case 0x61: *out = (uint64_t)(int64_t)(int16_t)read_be(p + 1, 2); return 0; /* short */
+    case 0x70: *out = read_be(p + 1, 4); return 0;               /* uint */
+    case 0x71: *out = (uint64_t)(int64_t)(int32_t)read_be(p + 1, 4); return 0; /* int */
+    case 0x80: case 0x81: *out = read_be(p + 1, 8); return 0;    /* ulong, long */
+    default: return -1;
+    }
+}
+
+int msg_view_get_bytes(const pn_bytes_t value, pn_bytes_t *out) {
+    if (value.size == 0) {
+        return -1;
+    }
+    switch ((unsigned char)value.start[0]) {
+    case 0xa0: case 0xa1: case 0xa3:
+        *out = pn_bytes(value.size - 2, value.start + 2);
+        return 0;
+    case 0xb0: case 0xb1: case 0xb3:
+        *out = pn_bytes(value.size - 5, value.start + 5);
+        return 0;
+    default: return -1;
+    }
+}
@@ -0,0 +1,120 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifndef MSG_VIEW_H
+#define MSG_VIEW_H 1
+
+
+#include <proton/codec.h>
+#include <proton/types.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/*
+ * A read only view of an encoded AMQP message.
+ *
+ * msg_view_parse only walks the section boundaries of the received bytes,
+ * nothing is decoded or copied. Each field points at the encoded value of
+ * its section inside the receive buffer and is empty if the section is
+ * absent. The view is valid as long as the receive buffer is.
+ *
+ * Use the msg_view_* readers to fetch individual values, or pn_data_decode
+ * a single section when all of it is needed.
+ * */
+typedef struct msg_view_t {
+  pn_bytes_t header;                  /* encoded list */
+  pn_bytes_t message_annotations;     /* encoded map */
+  pn_bytes_t properties;              /* encoded list */
+  pn_bytes_t application_properties;  /* encoded map */
+  pn_bytes_t body;                    /* encoded value of the first body section */
+  uint8_t body_code;                  /* body section descriptor code, 0 if no body */
+  int body_sections;                  /* number of body sections, data and amqp-sequence may repeat */
+} msg_view_t;
+
+/* AMQP 1.0 section descriptor codes */
+#define MSG_VIEW_HEADER 0x70
+#define MSG_VIEW_DELIVERY_ANNOTATIONS 0x71
+#define MSG_VIEW_MESSAGE_ANNOTATIONS 0x72
+#define MSG_VIEW_PROPERTIES 0x73
+#define MSG_VIEW_APPLICATION_PROPERTIES 0x74
+#define MSG_VIEW_DATA 0x75
+#define MSG_VIEW_AMQP_SEQUENCE 0x76
+#define MSG_VIEW_AMQP_VALUE 0x77
+#define MSG_VIEW_FOOTER 0x78
+
+/* Field indexes of the properties section list */
+#define MSG_VIEW_MESSAGE_ID 0
+#define MSG_VIEW_TO 2
+#define MSG_VIEW_SUBJECT 3
+
+/*
+ * Finds the sections of an encoded message.
+ *
+ * @param[out]: view, the section views
+ * @param[in]: data, the encoded message, must outlive the view
+ *
+ * @returns: 0 on success, PN_ERR if the bytes are not a well formed message
+ * */
+int msg_view_parse(msg_view_t *view, const pn_bytes_t data);
+
+/*
+ * Returns the body contents without copying when the body is a single
+ * data section or an amqp-value holding a string, symbol or binary.
+ *
+ * @param[in]: view, a parsed view
+ * @param[out]: bytes, the body contents
+ *
+ * @returns: PN_BINARY, PN_STRING or PN_SYMBOL, PN_NULL if the body is absent or of another type
+ * */
+pn_type_t msg_view_body(const msg_view_t *view, pn_bytes_t *bytes);
+
+/*
+ * Finds the encoded value of a list element, eg. a properties section field.
+ *
+ * @returns: 0 if the element is present, -1 otherwise
+ * */
+int msg_view_list_get(const pn_bytes_t list, const size_t index, pn_bytes_t *value);
+
+/*
+ * Finds the encoded value of a string or symbol key in a map, eg. an
+ * application property.
+ *
+ * @returns: 0 if the key is present, -1 otherwise
+ * */
+int msg_view_map_get(const pn_bytes_t map, const char *key, const size_t key_len, pn_bytes_t *value);
+
+/*
+ * Reads an encoded unsigned or signed integer value of any width.
+ *
+ * @returns: 0 on success, -1 if the value is not an integer
+ * */
+int msg_view_get_ulong(const pn_bytes_t value, uint64_t *out);
+
+/*
+ * Reads the contents of an encoded string, symbol or binary value.
+ *
+ * @returns: 0 on success, -1 if the value is of another type
+ * */
+int msg_view_get_bytes(const pn_bytes_t value, pn_bytes_t *out);
+
+#endif /* msg_view.h */
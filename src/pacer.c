@@ -0,0 +1,51 @@
+
+#include "pacer.h"
+
+#include <limits.h>
+#include <stdint.h>
+
+#define NS_PER_SEC 1000000000.0
+
+void pacer_init(pacer_t *pacer, const int rate, const int burst) {
+    pacer->rate = rate;
+    pacer->burst = burst > 0 ? burst : (rate / 250 > 0 ? rate / 250 : 1);
+    pacer->start_ns = 0;
+    pacer->released = 0;
+}
+
+int pacer_available(pacer_t *pacer, const uint64_t now_ns) {
+    if (pacer->start_ns == 0) {
+        pacer->start_ns = now_ns;
+    }
+    /* tokens accrued since the start, the first one is due immediately */
+    uint64_t accrued = (uint64_t)((now_ns - pacer->start_ns) * pacer->rate / NS_PER_SEC) + 1;
+    if (accrued <= pacer->released) {
+        return 0;
+    }
+    uint64_t due = accrued - pacer->released;
+    return due > (uint64_t)pacer->burst ? pacer->burst : (int)due;
+}
+
+uint64_t pacer_take(pacer_t *pacer) {
+    uint64_t scheduled = pacer->start_ns + (uint64_t)(pacer->released * NS_PER_SEC / pacer->rate);
+    pacer->released++;
+    return scheduled;
+}
+
+int pacer_wait_ms(const pacer_t *pacer, const uint64_t now_ns) {
+    if (pacer->start_ns == 0) {
+        return 1;
+    }
+    uint64_t accrued = (uint64_t)((now_ns - pacer->start_ns) * pacer->rate / NS_PER_SEC) + 1;
+    if (accrued > pacer->released + (uint64_t)pacer->burst) {
+        return 1; /* behind by more than a burst, catch up at the next tick */
+    }
+    /* due tokens not yet taken are sent on the next credit or acknowledgement */
+    uint64_t next = accrued > pacer->released ? accrued : pacer->released;
+    uint64_t due_ns = pacer->start_ns + (uint64_t)(next * NS_PER_SEC / pacer->rate);
+    if (due_ns <= now_ns) {
+        return 1;
+    }
+    uint64_t wait = (due_ns - now_ns + 999999) / 1000000;
+    return wait > INT_MAX ? INT_MAX : (int)wait;
+}
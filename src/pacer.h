@@ -0,0 +1,75 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifndef PACER_H
+#define PACER_H 1
+
+
+#include <stdint.h>
+
+
+/*
+ * Token bucket that releases messages on a fixed schedule.
+ *
+ * Tokens accrue at 'rate' per second from the first call to
+ * pacer_available and at most 'burst' of them are handed out at once.
+ * Tokens that could not be spent are never discarded, each one keeps its
+ * scheduled time, so a sender that falls behind catches up in bursts and
+ * the delay shows up as lag instead of as a lower offered load.
+ * */
+typedef struct pacer_t {
+  double rate;         /* messages per second */
+  int burst;           /* maximum tokens handed out at once */
+  uint64_t start_ns;   /* monotonic time of the first token, 0 until started */
+  uint64_t released;   /* tokens handed out so far */
+} pacer_t;
+
+/*
+ * Initializes the pacer.
+ *
+ * @param[out]: pacer, the pacer to initialize
+ * @param[in]: rate, messages per second, must be > 0
+ * @param[in]: burst, maximum messages released at once, 0 picks 4ms worth of messages
+ * */
+void pacer_init(pacer_t *pacer, const int rate, const int burst);
+
+/*
+ * Returns the number of messages due at now_ns, capped at the burst size.
+ * Starts the schedule on the first call.
+ * */
+int pacer_available(pacer_t *pacer, const uint64_t now_ns);
+
+/*
+ * Takes a token.
+ *
+ * @returns: the scheduled monotonic send time of the message
+ * */
+uint64_t pacer_take(pacer_t *pacer);
+
+/*
+ * Returns the milliseconds until the next token not yet due at now_ns,
+ * so a paced sender sleeps between tokens instead of polling. Tokens
+ * already due are left to the caller: 1 if more than a burst is due or
+ * the schedule has not started. Never less than 1.
+ * */
+int pacer_wait_ms(const pacer_t *pacer, const uint64_t now_ns);
+
+#endif /* pacer.h */
@@ -0,0 +1,188 @@
+
+#include "payload.h"
+
+#include <proton/types.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* xorshift64, cheap enough to call per message */
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static int parse_size_value(const char *s, char **end, size_t *value) {
+    errno = 0;
+    unsigned long long v = strtoull(s, end, 10);
+    if (errno != 0 || *end == s) {
+        return -1;
+    }
+    *value = (size_t)v;
+    return 0;
+}
+
+/* True at the end of a size file line, blanks and a comment may follow the values */
+static bool line_end(const char *p) {
+    while (*p == ' ' || *p == '\t') p++;
+    return *p == '#' || *p == '\n' || *p == '\r' || *p == '\0';
+}
+
+static void free_sizes(payload_t *payload) {
+    free(payload->sizes);
+    free(payload->weights);
+    payload->sizes = NULL;
+    payload->weights = NULL;
+    payload->sizes_count = 0;
+}
+
+/* Reads '<size> [weight]' lines into the size table with cumulative weights */
+static int parse_size_file(payload_t *payload, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Unable to open payload size file: %s\n", path);
+        return -1;
+    }
+    size_t capacity = 16;
+    payload->sizes = (size_t*)malloc(capacity * sizeof(size_t));
+    payload->weights = (uint64_t*)malloc(capacity * sizeof(uint64_t));
+    payload->sizes_count = 0;
+    payload->min_size = SIZE_MAX;
+    payload->max_size = 0;
+    uint64_t total = 0;
+    char line[256];
+    int line_number = 0;
+    int rc = payload->sizes && payload->weights ? 0 : -1;
+    if (rc != 0) {
+        fprintf(stderr, "Unable to allocate payload sizes\n");
+    }
+    while (rc == 0 && fgets(line, sizeof(line), f)) {
+        line_number++;
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (line_end(p)) {
+            continue;
+        }
+        size_t size;
+        size_t weight = 1;
+        char *end;
+        if (parse_size_value(p, &end, &size) != 0
+            || (!line_end(end) && (parse_size_value(end, &end, &weight) != 0 || !line_end(end)))) {
+            fprintf(stderr, "%s:%d: expected a payload size and an optional weight: %s", path, line_number, line);
+            rc = -1;
+            break;
+        }
+        if (payload->sizes_count == capacity) {
+            capacity *= 2;
+            size_t *sizes = (size_t*)realloc(payload->sizes, capacity * sizeof(size_t));
+            if (sizes) {
+                payload->sizes = sizes;
+            }
+            uint64_t *weights = (uint64_t*)realloc(payload->weights, capacity * sizeof(uint64_t));
+            if (weights) {
+                payload->weights = weights;
+            }
+            if (!sizes || !weights) {
+                fprintf(stderr, "Unable to allocate payload sizes\n");
+                rc = -1;
+                break;
+            }
+        }
+        total += weight;
+        payload->sizes[payload->sizes_count] = size;
+        payload->weights[payload->sizes_count] = total;
+        payload->sizes_count++;
+        if (size < payload->min_size) payload->min_size = size;
+        if (size > payload->max_size) payload->max_size = size;
+    }
+    fclose(f);
+    if (rc == 0 && (payload->sizes_count == 0 || total == 0)) {
+        fprintf(stderr, "No payload sizes in file: %s\n", path);
+        rc = -1;
+    }
+    if (rc != 0) {
+        free_sizes(payload);
+    }
+    return rc;
+}
+
+int payload_parse_size(payload_t *payload, const char *spec) {
+    if (!payload || !spec) {
+        return -1;
+    }
+    if (spec[0] == '@') {
+        return parse_size_file(payload, spec + 1);
+    }
+    char *end;
+    if (parse_size_value(spec, &end, &payload->min_size) != 0) {
+        return -1;
+    }
+    payload->max_size = payload->min_size;
+    if (*end == '-') {
+        const char *max = end + 1;
+        if (parse_size_value(max, &end, &payload->max_size) != 0
+            || payload->max_size < payload->min_size) {
+            return -1;
+        }
+    }
+    return *end == '\0' ? 0 : -1;
+}
+
+int payload_generate(payload_t *payload, const bool binary) {
+    payload->binary = binary;
+    /* allocate at least one byte so an all zero size payload has a buffer */
+    const size_t size = payload->max_size > 0 ? payload->max_size : 1;
+    char *buf = (char*)malloc(size);
+    if (!buf) {
+        return -1;
+    }
+    uint64_t rng = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < size; i++) {
+        if (binary) {
+            buf[i] = (char)next_random(&rng);
+        } else {
+            buf[i] = 'a' + (char)(i % 26);
+        }
+    }
+    payload->buffer = pn_rwbytes(size, buf);
+    return 0;
+}
+
+size_t payload_next_size(const payload_t *payload, uint64_t *rng) {
+    if (payload->sizes) {
+        /* binary search the cumulative weights */
+        uint64_t pick = next_random(rng) % payload->weights[payload->sizes_count - 1];
+        size_t lo = 0, hi = payload->sizes_count - 1;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (pick < payload->weights[mid]) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        return payload->sizes[lo];
+    }
+    if (payload->max_size == payload->min_size) {
+        return payload->min_size;
+    }
+    return payload->min_size + next_random(rng) % (payload->max_size - payload->min_size + 1);
+}
+
+void payload_free(payload_t *payload) {
+    free(payload->buffer.start);
+    free(payload->sizes);
+    free(payload->weights);
+    payload->buffer = pn_rwbytes_null;
+    payload->sizes = NULL;
+    payload->weights = NULL;
+    payload->sizes_count = 0;
+}
@@ -0,0 +1,86 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifndef PAYLOAD_H
+#define PAYLOAD_H 1
+
+
+#include <proton/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/*
+ * Message body payload sizes and bytes for benchmarking.
+ *
+ * The payload bytes are generated once into a buffer as large as the
+ * biggest size that can be picked. Each message sends a prefix of that
+ * buffer, so nothing is rebuilt per message and the buffer can be shared
+ * read-only between threads.
+ * */
+typedef struct payload_t {
+  bool binary;            /* true for a data section, false for an amqp-value string */
+  size_t min_size;
+  size_t max_size;
+  size_t *sizes;          /* sizes read from a distribution file, NULL otherwise */
+  uint64_t *weights;      /* cumulative weight of each size */
+  size_t sizes_count;
+  pn_rwbytes_t buffer;    /* max_size generated payload bytes */
+} payload_t;
+
+/*
+ * Parses a payload size specification into the payload.
+ * The specification is one of:
+ *      '<size>', every body is size bytes
+ *      '<min>-<max>', body sizes are picked uniformly from min to max inclusive
+ *      '@<file>', body sizes are picked from a file of '<size> [weight]' lines,
+ *      lines starting with '#' are ignored and the weight defaults to 1
+ * returns:
+ *      0 on success, -1 if the specification or file is invalid
+ * */
+int payload_parse_size(payload_t *payload, const char *spec);
+
+/*
+ * Generates the payload bytes once the sizes are known. String payloads
+ * are printable ASCII, binary payloads are pseudo random bytes.
+ *
+ * @returns: 0 on success, -1 if allocation failed
+ * */
+int payload_generate(payload_t *payload, const bool binary);
+
+/*
+ * Picks the body size of the next message.
+ *
+ * @param[in]: payload, the parsed payload
+ * @param[in,out]: rng, caller owned random state, must not be 0
+ *
+ * @returns: the body size in bytes
+ * */
+size_t payload_next_size(const payload_t *payload, uint64_t *rng);
+
+/*
+ * Frees the payload buffer and size table.
+ * */
+void payload_free(payload_t *payload);
+
+#endif /* payload.h */
@@ -40,6 +40,19 @@
 #include <unistd.h>
 
 #include "util.h"
+#include "msg_template.h"
+#include "inflight.h"
+#include "histogram.h"
+#include "pacer.h"
+#include "payload.h"
+#include "stamp.h"
+#include "mapped_file.h"
+#include "spool.h"
+#include "reconnect.h"
+#include "conn_props.h"
+#include "addr_cache.h"
+#include "topic.h"
+#include "link_cache.h"
 
 typedef struct app_data_t {
   const char *host, *port;
@@ -48,11 +61,60 @@ typedef struct app_data_t {
   char *amqp_topic_prefix;
   const char *container_id;
   int message_count;
+  bool use_template;
+  int max_inflight;
+  bool presettled;
+  bool stamp;                  /* add send time and sequence properties */
+  bool payload_mode;           /* send generated payload bodies of -s sizes */
+  bool binary_body;
+  payload_t payload;           /* shared read-only once generated */
+  int rate;                    /* messages per second, 0 for unpaced */
+  int burst;
+  const char *stream_path;     /* file streamed as each message body, NULL if not streaming */
+  mapped_file_t stream_file;
+  const char *spool_path;      /* spool file messages are submitted to, NULL to send directly */
+  size_t spool_size;
+  spool_t spool;
+  int reconnect_attempts;      /* attempts to reopen a dropped connection, 0 to exit on a drop */
+  bool anonymous_relay;        /* one sender link with a null target, each message carries its to address */
+  const char *topic_file;      /* topics the messages go round robin over, NULL for the -t topic */
+  int topic_count;             /* topics generated from the -t pattern, 0 for none */
+  size_t address_cache;        /* bytes of prefixed topic addresses cached */
+  int link_cache_size;         /* sender links kept attached when publishing over a link per topic */
+  int link_sessions;           /* sessions the cached links are spread over */
+  bool topic_links;            /* a cached sender link per topic, the anonymous relay is not used */
 
   pn_proactor_t *proactor;
+  char addr[PN_MAX_ADDR];      /* broker address, reconnects go to the same one */
+  pn_connection_t *connection; /* NULL once the transport is closed */
+  pn_link_t *sender;
   pn_rwbytes_t message_buffer;
+  msg_template_t message_template; /* pre-encoded message for template mode */
   int sent;
   int acknowledged;
+  inflight_t inflight;         /* unsettled deliveries by delivery tag */
+  histogram_t ack_latency;     /* publish to acknowledgement time */
+  pacer_t pacer;
+  uint64_t rng;                /* payload size picker state */
+  size_t stamp_time_offset;    /* template offsets of the stamp property values */
+  size_t stamp_sequence_offset;
+  histogram_t send_lag;        /* actual minus scheduled send time when paced */
+  pn_delivery_t *stream_delivery; /* delivery whose body is still being streamed */
+  size_t stream_offset;        /* body bytes of stream_delivery sent so far */
+  bool send_done;              /* all pre-settled messages sent */
+  int spool_unacked;           /* spooled messages sent and not yet acknowledged */
+  int spool_rejected;          /* spooled messages the peer rejected, completed without a resend */
+  bool finished;               /* the connection was closed on purpose, it is not reopened */
+  reconnect_t reconnect;
+  conn_props_t conn_props;     /* the broker's open frame properties and capabilities */
+  int *resend;                 /* tags unsettled when the connection dropped, sent again first */
+  size_t resend_count;
+  size_t resend_next;
+  topic_list_t topics;         /* per message topics, empty when the link target addresses every message */
+  addr_cache_t addresses;      /* prefixed topic addresses */
+  char to_section[PN_MAX_ADDR + 256]; /* the template properties section with the current message's to address */
+  uint64_t first_send_ns;      /* start of the per topic rates */
+  link_cache_t links;          /* sender links by prefixed topic address */
 } app_data_t;
 
 static int exit_code = 0;
@@ -64,7 +126,7 @@ extern int opterr;
 
 #define str_free(strptr) free((void *)strptr)
 
-static void check_condition(pn_event_t *e, pn_condition_t *cond) {
+static void check_condition(app_data_t *app, pn_event_t *e, pn_condition_t *cond) {
   if (pn_condition_is_set(cond)) {
     fprintf(stderr, "%s: %s: %s\n", pn_event_type_name(pn_event_type(e)),
             pn_condition_get_name(cond), pn_condition_get_description(cond));
@@ -87,7 +149,10 @@ static void check_condition(pn_event_t *e, pn_condition_t *cond) {
 
     }
     pn_connection_close(pn_event_connection(e));
-    exit_code = 1;
+    /* a dropped connection is only an error once it cannot be reopened */
+    if (app->reconnect.max_attempts == 0) {
+      exit_code = 1;
+    }
   }
 }
 
@@ -95,28 +160,28 @@ static void check_condition(pn_event_t *e, pn_condition_t *cond) {
 #define TOPIC_PREFIX_KEY_SIZE sizeof(TOPIC_PREFIX_KEY)
 #define TOPIC_PREFIX_KEY_LEN TOPIC_PREFIX_KEY_SIZE -1
 
+/* Offered by brokers that route messages sent on a link with a null target by their to address */
+#define ANONYMOUS_RELAY_CAPABILITY "ANONYMOUS-RELAY"
+
 /* 
  * Certain brokers have AMQP connections may advertise their topic prefix in the 
  * connection open response. It is possible to read the topic prefix value from 
  * the connection open response. Solace Pubsub+ advertises the topic prefix
  * with the 'topic-prefix' property key.
  * 
- * set_topic_prefix_from_connection checks the remote AMQP connection properties 
- * for the 'topic-prefix' property key and reads and assign the amqp topic prefix
+ * set_topic_prefix_from_connection checks the remote AMQP connection properties
+ * index for the 'topic-prefix' property key and reads and assign the amqp topic prefix
  * to app_data_t if the property is present.
  *
  * */
-static int set_topic_prefix_from_connection(app_data_t* app, pn_connection_t* pnc){
-    pn_data_t* properties = pn_connection_remote_properties(pnc);
+static int set_topic_prefix_from_connection(app_data_t *app) {
     static const size_t amqp_topic_prefix_len = 255;
     char amqp_topic_prefix[amqp_topic_prefix_len];
-    /* get remote connection property value */
-    int rc = get_data_map_string_property(properties, 
-                                          TOPIC_PREFIX_KEY, 
-                                          amqp_topic_prefix, 
-                                          amqp_topic_prefix_len);
+    /* look the property up in the index decoded when the connection opened */
+    int rc = conn_props_get_string(&app->conn_props, TOPIC_PREFIX_KEY,
+                                   amqp_topic_prefix, amqp_topic_prefix_len);
     /* 
-     * < 0 indicates not found or invalid arguments
+     * < 0 indicates not found
      * 
      * = 0 indicates property is present but is not representable as a string 
      * or does not fit in buffer
@@ -131,23 +196,46 @@ static int set_topic_prefix_from_connection(app_data_t* app, pn_connection_t* pn
     return rc;
 }
 
+/* The topic of a message, messages go round robin over the topics by sequence so a resend keeps its topic */
+static topic_t* message_topic(app_data_t* app, int sequence) {
+  return &app->topics.items[(sequence - 1) % app->topics.count];
+}
+
+/* The prefixed to address of a topic, formatted once and cached */
+static const char* topic_address(app_data_t* app, const topic_t* topic) {
+  const char* address = addr_cache_get(&app->addresses, topic->name, topic->name_len,
+                                       app->amqp_topic_prefix, strlen(app->amqp_topic_prefix));
+  if (!address) {
+    fprintf(stderr, "Unable to allocate address of topic %s\n", topic->name);
+    exit(1);
+  }
+  return address;
+}
+
 /* Create a message with a string "sequence_<number>" encode it and return the encoded buffer. */
-static pn_bytes_t encode_message(app_data_t* app) {
-  /* Construct a message with the string "sequence_<app.sent>" */
+static pn_bytes_t encode_message(app_data_t* app, int sequence, const char* to) {
+  /* Construct a message with the string "sequence_<sequence>" */
   pn_message_t* message = pn_message();
   pn_data_t* body = pn_message_body(message);
   /* Create string for amqp message body */
   size_t slen = sizeof("sequence_") + 12;
   char* sbuf = malloc(slen);
-  int swritten = sprintf(sbuf, "sequence_%d", app->sent);
+  int swritten = sprintf(sbuf, "sequence_%d", sequence);
   if (swritten < 0) {
-    fprintf(stderr, "error writing message body string for sequence %d", app->sent);
+    fprintf(stderr, "error writing message body string for sequence %d", sequence);
     exit(1);
   }
   pn_data_put_string(body, pn_bytes(swritten, sbuf));
+  free(sbuf); /* the body data holds its own copy */
 
   /* set message durable flag */
   pn_message_set_durable(message, true);
+  if (to) {
+    pn_message_set_address(message, to);
+  }
+  if (app->stamp) {
+    stamp_message(message, realtime_ns(), sequence);
+  }
 
   /* encode the message, expanding the encode buffer as needed */
   if (app->message_buffer.start == NULL) {
@@ -174,6 +262,392 @@ static pn_bytes_t encode_message(app_data_t* app) {
   }
 }
 
+/*
+ * Encode the message sections that are the same for every message once.
+ * encode_message_from_template then only patches the "sequence_<number>"
+ * body, avoiding a pn_message_t, a body string and a full encode per message.
+ * With -s the template ends at the body section header and send_message
+ * follows it with the generated payload bytes, with -f the file is streamed
+ * after it as a data section.
+ */
+static void init_message_template(app_data_t* app) {
+  pn_message_t* message = pn_message();
+  /* set message durable flag */
+  pn_message_set_durable(message, true);
+  if (app->stamp) {
+    /* placeholders located after encoding and patched per message */
+    stamp_message(message, STAMP_TIME_PLACEHOLDER, STAMP_SEQUENCE_PLACEHOLDER);
+  }
+  int status = app->stream_path
+    ? msg_template_init_payload(&app->message_template, message, true)
+    : app->payload_mode
+    ? msg_template_init_payload(&app->message_template, message, app->binary_body)
+    : msg_template_init(&app->message_template, message, "sequence_");
+  if (status != 0) {
+    fprintf(stderr, "error encoding message template: %s\n", pn_code(status));
+    exit(1);
+  }
+  if (app->stamp
+      && (msg_template_find_ulong(&app->message_template, STAMP_TIME_PLACEHOLDER, &app->stamp_time_offset) != 0
+          || msg_template_find_ulong(&app->message_template, STAMP_SEQUENCE_PLACEHOLDER, &app->stamp_sequence_offset) != 0)) {
+    fprintf(stderr, "error locating stamp properties in message template\n");
+    exit(1);
+  }
+  pn_message_free(message);
+}
+
+static pn_bytes_t encode_message_from_template(app_data_t* app, int sequence) {
+  return msg_template_encode(&app->message_template, sequence);
+}
+
+/*
+ * Splits the template bytes in parts[0] around its properties section and
+ * puts the same section with the to address set in its place, so the
+ * template is shared by every topic. Returns the new number of parts.
+ */
+static int address_parts(app_data_t* app, const char* to, pn_bytes_t parts[4], int count) {
+  const msg_template_t* tmpl = &app->message_template;
+  size_t size = msg_template_encode_to(tmpl, app->to_section, sizeof(app->to_section), to, strlen(to));
+  if (size == 0) {
+    fprintf(stderr, "Topic address too long: %s\n", to);
+    exit(1);
+  }
+  if (count > 1) {
+    parts[3] = parts[1];
+  }
+  parts[2] = pn_bytes(parts[0].size - tmpl->properties_end, parts[0].start + tmpl->properties_end);
+  parts[1] = pn_bytes(size, app->to_section);
+  parts[0] = pn_bytes(tmpl->properties_offset, parts[0].start);
+  return count + 2;
+}
+
+/*
+ * Encode a message into up to four parts: the encoded sections, split
+ * around the to address when there are topics, then the body bytes when
+ * they are sent separately. Returns the number of parts.
+ */
+static int encode_parts(app_data_t* app, int sequence, pn_bytes_t parts[4]) {
+  /* on a link per topic the link target addresses the message */
+  const char* to = app->topics.count > 0 && !app->topic_links ? topic_address(app, message_topic(app, sequence)) : NULL;
+  int count = 1;
+  if (app->stamp && (app->use_template || app->payload_mode || app->stream_path)) {
+    msg_template_patch_ulong(&app->message_template, app->stamp_time_offset, realtime_ns());
+    msg_template_patch_ulong(&app->message_template, app->stamp_sequence_offset, sequence);
+  }
+  if (app->stream_path) {
+    /* only the sections up to the body, stream_message sends the file bytes */
+    parts[0] = msg_template_encode_payload(&app->message_template, app->stream_file.bytes.size);
+  } else if (app->payload_mode) {
+    /* the pre-encoded sections then a prefix of the shared payload bytes */
+    size_t size = payload_next_size(&app->payload, &app->rng);
+    parts[0] = msg_template_encode_payload(&app->message_template, size);
+    parts[1] = pn_bytes(size, app->payload.buffer.start);
+    count = 2;
+  } else if (app->use_template) {
+    parts[0] = encode_message_from_template(app, sequence);
+  } else {
+    /* the to address is encoded with the rest of the message */
+    parts[0] = encode_message(app, sequence, to);
+    return 1;
+  }
+  return to ? address_parts(app, to, parts, count) : count;
+}
+
+/* Encode and send the message for the current delivery, returns the bytes sent */
+static size_t send_message(app_data_t* app, pn_link_t* sender, int sequence) {
+  pn_bytes_t parts[4];
+  int count = encode_parts(app, sequence, parts);
+  size_t bytes = 0;
+  for (int i = 0; i < count; i++) {
+    pn_link_send(sender, parts[i].start, parts[i].size);
+    bytes += parts[i].size;
+  }
+  return bytes;
+}
+
+/* Counts the first send of a message to its topic */
+static void count_topic(app_data_t* app, int sequence, size_t bytes) {
+  if (app->topics.count == 0) {
+    return;
+  }
+  if (app->first_send_ns == 0) {
+    app->first_send_ns = monotonic_time_ns();
+  }
+  topic_t* topic = message_topic(app, sequence);
+  topic->sent++;
+  topic->bytes += bytes;
+}
+
+/* Complete the current delivery, settling it up front when pre-settled */
+static void finish_delivery(app_data_t* app, pn_link_t* sender, pn_delivery_t* d) {
+  pn_link_advance(sender);
+  if (app->presettled) {
+    /* fire and forget, the peer sends no disposition for settled deliveries */
+    pn_delivery_settle(d);
+  }
+}
+
+/* Size of each partial send of a streamed body */
+#define STREAM_CHUNK (64 * 1024)
+
+/* Streamed body bytes allowed to wait in the session for transfer frames */
+#define STREAM_WINDOW (1024 * 1024)
+
+/*
+ * Send the next chunks of the streamed body while the session has room,
+ * dropping the consumed pages of the mapping as it goes. Returns true once
+ * the delivery is complete, false if the rest waits for the next send tick.
+ */
+static bool stream_message(app_data_t* app, pn_link_t* sender) {
+  mapped_file_t* file = &app->stream_file;
+  pn_session_t* session = pn_link_session(sender);
+  while (app->stream_offset < file->bytes.size && pn_session_outgoing_bytes(session) < STREAM_WINDOW) {
+    size_t chunk = file->bytes.size - app->stream_offset;
+    if (chunk > STREAM_CHUNK) chunk = STREAM_CHUNK;
+    /* pn_link_send copies the bytes, the pages are no longer needed */
+    pn_link_send(sender, file->bytes.start + app->stream_offset, chunk);
+    mapped_file_release(file, app->stream_offset, chunk);
+    app->stream_offset += chunk;
+  }
+  if (app->stream_offset < file->bytes.size) {
+    return false;
+  }
+  finish_delivery(app, sender, app->stream_delivery);
+  app->stream_delivery = NULL;
+  return true;
+}
+
+/* Returns the integer delivery tag set from the sent counter, 0 if not recognized */
+static int delivery_tag_id(pn_delivery_t* d) {
+  pn_delivery_tag_t tag = pn_delivery_tag(d);
+  int id = 0;
+  if (tag.size == sizeof(id)) {
+    memcpy(&id, tag.start, sizeof(id));
+  }
+  return id;
+}
+
+/*
+ * Submit the messages due by now to the spool. Never waits on the network,
+ * returns false if the spool is full and the rest wait for a later tick.
+ */
+static bool submit_messages(app_data_t* app) {
+  int tokens = app->rate > 0 ? pacer_available(&app->pacer, monotonic_time_ns()) : app->message_count;
+  while (tokens > 0 && app->sent < app->message_count) {
+    pn_bytes_t parts[4];
+    ++app->sent;
+    int count = encode_parts(app, app->sent, parts);
+    if (spool_submit(&app->spool, parts, count) != 0) {
+      --app->sent;
+      return false;
+    }
+    size_t bytes = 0;
+    for (int i = 0; i < count; i++) {
+      bytes += parts[i].size;
+    }
+    count_topic(app, app->sent, bytes);
+    if (app->rate > 0) {
+      uint64_t now = monotonic_time_ns();
+      uint64_t scheduled = pacer_take(&app->pacer);
+      histogram_record(&app->send_lag, now > scheduled ? now - scheduled : 0);
+      --tokens;
+    }
+  }
+  return true;
+}
+
+/*
+ * Send spooled messages while the peer has given credit and the in-flight
+ * window has room, then close once every message was submitted and the
+ * spool has drained.
+ */
+static void send_spooled(app_data_t* app, pn_link_t* sender) {
+  uint64_t id;
+  pn_bytes_t message;
+  while (pn_link_credit(sender) > 0 && (app->presettled || app->spool_unacked < app->max_inflight)
+         && spool_next(&app->spool, monotonic_time_ns(), &id, &message)) {
+    /* the spool position is the delivery tag, it identifies the entry to complete */
+    pn_delivery_t* d = pn_delivery(sender, pn_dtag((const char *)&id, sizeof(id)));
+    pn_link_send(sender, message.start, message.size);
+    finish_delivery(app, sender, d);
+    if (app->presettled) {
+      spool_complete(&app->spool, id, NULL);
+      ++app->acknowledged;
+    } else {
+      ++app->spool_unacked;
+    }
+  }
+  if (!app->send_done && app->sent == app->message_count && spool_empty(&app->spool)) {
+    app->send_done = true;
+    app->finished = true;
+    printf("%d messages sent %s\n", app->acknowledged, app->presettled ? "pre-settled" : "and acknowledged");
+    if (app->spool_rejected > 0) {
+      fprintf(stderr, "%d spooled messages were rejected by the peer\n", app->spool_rejected);
+      exit_code = 1;
+    }
+    pn_connection_close(pn_session_connection(pn_link_session(sender)));
+  }
+}
+
+/* Send the messages queued on a topic link while it has credit */
+static void send_queued(app_data_t* app, link_entry_t* entry) {
+  link_message_t message;
+  while (pn_link_credit(entry->link) > 0 && link_cache_pop(&app->links, entry, &message)) {
+    pn_delivery_t* d = pn_delivery(entry->link, pn_dtag((const char *)&message.tag, sizeof(message.tag)));
+    size_t bytes = send_message(app, entry->link, message.tag);
+    if (!message.resend) {
+      count_topic(app, message.tag, bytes);
+    }
+    finish_delivery(app, entry->link, d);
+  }
+}
+
+/*
+ * Publish over a cached sender link per topic. Each message is queued on
+ * its topic's link, attaching the link on a miss, and sent as soon as the
+ * link has credit, so a topic waiting for its attach does not hold up the
+ * others. Queued messages count against the in-flight window.
+ */
+static void send_to_topics(app_data_t* app) {
+  if (!app->links.sessions) {
+    return; /* not connected */
+  }
+  int tokens = app->rate > 0 ? pacer_available(&app->pacer, monotonic_time_ns()) : 1;
+  while (tokens > 0 && (app->resend_next < app->resend_count || app->sent < app->message_count)) {
+    const bool resend = app->resend_next < app->resend_count;
+    int sequence = resend ? app->resend[app->resend_next] : app->sent + 1;
+    if (app->presettled ? app->links.queued >= (size_t)app->max_inflight
+                        : !inflight_available(&app->inflight, sequence)) {
+      break;
+    }
+    const char* address = topic_address(app, message_topic(app, sequence));
+    link_entry_t* entry = link_cache_get(&app->links, address, strlen(address));
+    link_message_t message = { sequence, resend };
+    if (!entry || link_cache_push(&app->links, entry, message) != 0) {
+      fprintf(stderr, "Unable to allocate sender link to %s\n", address);
+      exit(1);
+    }
+    if (resend) {
+      app->resend_next++;
+    } else {
+      ++app->sent;
+    }
+    {
+    uint64_t now = monotonic_time_ns();
+    uint64_t scheduled = now;
+    if (app->rate > 0) {
+      scheduled = pacer_take(&app->pacer);
+      histogram_record(&app->send_lag, now > scheduled ? now - scheduled : 0);
+      --tokens;
+    }
+    if (!app->presettled) {
+      /* latency includes the time queued for the attach */
+      inflight_add(&app->inflight, sequence, scheduled);
+    }
+    }
+    send_queued(app, entry);
+  }
+  if (app->presettled && !app->send_done && app->sent == app->message_count && app->links.queued == 0) {
+    app->send_done = true;
+    app->finished = true;
+    printf("%d messages sent pre-settled\n", app->sent);
+    pn_connection_close(app->connection);
+  }
+}
+
+/*
+ * Send messages while the peer has given credit and the in-flight window
+ * has a free slot for the next delivery tag. When paced only the messages
+ * due by now are sent, the rest wait for the next send tick. A streamed
+ * body is finished before the next message is started.
+ */
+static void send_messages(app_data_t* app, pn_link_t* sender) {
+  if (app->topic_links) {
+    send_to_topics(app);
+    return;
+  }
+  if (app->spool_path) {
+    submit_messages(app);
+    send_spooled(app, sender);
+    return;
+  }
+  if (app->stream_delivery && !stream_message(app, sender)) {
+    return;
+  }
+  int tokens = app->rate > 0 ? pacer_available(&app->pacer, monotonic_time_ns()) : 1;
+  while (tokens > 0 && pn_link_credit(sender) > 0
+         && (app->resend_next < app->resend_count || app->sent < app->message_count)) {
+    /* deliveries left unsettled by a dropped connection go first */
+    const bool resend = app->resend_next < app->resend_count;
+    int sequence = resend ? app->resend[app->resend_next] : app->sent + 1;
+    if (!app->presettled && !inflight_available(&app->inflight, sequence)) {
+      break;
+    }
+    if (resend) {
+      app->resend_next++;
+    } else {
+      ++app->sent;
+    }
+    /* Use the sequence number as unique delivery tag. */
+    pn_delivery_t* d = pn_delivery(sender, pn_dtag((const char *)&sequence, sizeof(sequence)));
+    {
+    uint64_t now = monotonic_time_ns();
+    uint64_t scheduled = now;
+    if (app->rate > 0) {
+      /* latency is measured from the scheduled time so sender stalls are not hidden */
+      scheduled = pacer_take(&app->pacer);
+      histogram_record(&app->send_lag, now > scheduled ? now - scheduled : 0);
+      --tokens;
+    }
+    if (!app->presettled) {
+      inflight_add(&app->inflight, sequence, scheduled);
+    }
+    size_t bytes = send_message(app, sender, sequence);
+    if (!resend) {
+      /* a streamed body follows the sections */
+      count_topic(app, sequence, bytes + (app->stream_path ? app->stream_file.bytes.size : 0));
+    }
+    }
+    if (app->stream_path) {
+      app->stream_delivery = d;
+      app->stream_offset = 0;
+      if (!stream_message(app, sender)) {
+        break;
+      }
+    } else {
+      finish_delivery(app, sender, d);
+    }
+  }
+  if (app->presettled && !app->send_done && !app->stream_delivery && app->sent == app->message_count) {
+    app->send_done = true;
+    app->finished = true;
+    printf("%d messages sent pre-settled\n", app->sent);
+    pn_connection_close(pn_session_connection(pn_link_session(sender)));
+    /* Continue handling events till we receive TRANSPORT_CLOSED */
+  }
+}
+
+/* Interval of the send tick resuming streamed and spooled sends */
+#define SEND_TICK_MS 1
+
+/* When paced the send tick sleeps until the next message is due instead of polling */
+static int send_tick_ms(app_data_t* app) {
+  if (app->stream_path || app->spool_path || app->rate == 0) {
+    return SEND_TICK_MS;
+  }
+  return pacer_wait_ms(&app->pacer, monotonic_time_ns());
+}
+
+/* Open a connection, its handlers attach the same link with the same terminus on every connection */
+static void connect_broker(app_data_t* app) {
+  pn_connection_t* c = pn_connection();
+  /* Initial Sasl transport for authentication */
+  pn_transport_t *pnt = pn_transport();
+  pn_sasl_set_allow_insecure_mechs(pn_sasl(pnt), true);
+  app->connection = c;
+  pn_proactor_connect2(app->proactor, c, pnt, app->addr);
+}
+
 /* Returns true to continue, false if finished */
 static bool handle(app_data_t* app, pn_event_t* event) {
   switch (pn_event_type(event)) {
@@ -187,28 +661,62 @@ static bool handle(app_data_t* app, pn_event_t* event) {
      }
      pn_connection_set_container(c, app->container_id);
      pn_connection_open(c);
+     app->connection = c;
      break;
    }
     
    case PN_CONNECTION_REMOTE_OPEN: {
      char amqp_topic[PN_MAX_ADDR];
      pn_connection_t* c = pn_event_connection(event);
-     set_topic_prefix_from_connection(app, c);
+     reconnect_opened(&app->reconnect, monotonic_time_ns());
+     /* decode the broker properties and capabilities once for this connection */
+     if (conn_props_load(&app->conn_props, c) != 0) {
+       fprintf(stderr, "Unable to allocate connection properties index\n");
+       exit(1);
+     }
+     set_topic_prefix_from_connection(app);
+     if (app->anonymous_relay && !app->topic_links && !app->spool_path && !app->stream_path
+         && !conn_props_has_capability(&app->conn_props, ANONYMOUS_RELAY_CAPABILITY)) {
+       fprintf(stderr, "broker does not offer %s, publishing over a link per topic\n", ANONYMOUS_RELAY_CAPABILITY);
+       app->topic_links = true;
+     }
+     if (app->topic_links) {
+       if (link_cache_open(&app->links, c) != 0) {
+         fprintf(stderr, "Unable to allocate sessions\n");
+         exit(1);
+       }
+       printf("publishing to %d topics over up to %d cached links on %d sessions\n",
+              app->topics.count, app->link_cache_size, app->link_sessions);
+       break;
+     }
      pn_session_t* s = pn_session(c);
      pn_session_open(s);
      {
      pn_link_t* l = pn_sender(s, "my_sender");
-     /* add topic prefix to amqp address */
-     if(amqp_destination_address(
-        amqp_topic, PN_MAX_ADDR,
-        app->amqp_address, strlen(app->amqp_address),
-        app->amqp_topic_prefix, strlen(app->amqp_topic_prefix) 
-        ) < 0) {
-        exit_code=1;
-        return false;
+     app->sender = l;
+     if (app->anonymous_relay) {
+       /* a null target, the broker routes each message by its to address */
+       if (!conn_props_has_capability(&app->conn_props, ANONYMOUS_RELAY_CAPABILITY)) {
+         fprintf(stderr, "broker does not offer %s, attaching the anonymous link anyway\n", ANONYMOUS_RELAY_CAPABILITY);
+       }
+       printf("publishing to %d topics over an anonymous relay link\n", app->topics.count);
+     } else {
+       /* add topic prefix to amqp address */
+       if(amqp_destination_address(
+          amqp_topic, PN_MAX_ADDR,
+          app->amqp_address, strlen(app->amqp_address),
+          app->amqp_topic_prefix, strlen(app->amqp_topic_prefix) 
+          ) < 0) {
+          exit_code=1;
+          return false;
+       }
+       printf("setting amqp topic:'%s'\n", amqp_topic);
+       pn_terminus_set_address(pn_link_target(l), amqp_topic);
+     }
+     if (app->presettled) {
+       /* tell the peer all deliveries on this link are sent settled */
+       pn_link_set_snd_settle_mode(l, PN_SND_SETTLED);
      }
-     printf("setting amqp topic:'%s'\n", amqp_topic);
-     pn_terminus_set_address(pn_link_target(l), amqp_topic);
      pn_link_open(l);
      break;
      }
@@ -217,56 +725,156 @@ static bool handle(app_data_t* app, pn_event_t* event) {
 
    case PN_LINK_FLOW: {
      /* The peer has given us some credit, now we can send messages */
-     pn_link_t *sender = pn_event_link(event);
-     while (pn_link_credit(sender) > 0 && app->sent < app->message_count) {
-       ++app->sent;
-       /* Use sent counter as unique delivery tag. */
-       pn_delivery(sender, pn_dtag((const char *)&app->sent, sizeof(app->sent)));
-       {
-       pn_bytes_t msgbuf = encode_message(app);
-       pn_link_send(sender, msgbuf.start, msgbuf.size);
+     if (app->topic_links) {
+       /* first the messages queued while the link attached, NULL once evicted */
+       link_entry_t* entry = (link_entry_t*)pn_link_get_context(pn_event_link(event));
+       if (entry) {
+         send_queued(app, entry);
        }
-       pn_link_advance(sender);
      }
+     send_messages(app, pn_event_link(event));
      break;
    }
 
    case PN_DELIVERY: {
      /* We received acknowledgement from the peer that a message was delivered. */
      pn_delivery_t* d = pn_event_delivery(event);
+     const uint64_t state = pn_delivery_remote_state(d);
+     if (app->spool_path && (state == PN_ACCEPTED || state == PN_REJECTED
+                             || state == PN_RELEASED || state == PN_MODIFIED)) {
+       uint64_t id = 0, sent_ns = 0;
+       pn_delivery_tag_t tag = pn_delivery_tag(d);
+       if (tag.size == sizeof(id)) {
+         memcpy(&id, tag.start, sizeof(id));
+       }
+       if (state == PN_RELEASED || state == PN_MODIFIED) {
+         /* the peer did not take the message, only this entry is sent again */
+         spool_release(&app->spool, id);
+       } else {
+         /* the message is safe with the peer or will never be, free its space in the spool */
+         spool_complete(&app->spool, id, &sent_ns);
+         if (sent_ns > 0) {
+           histogram_record(&app->ack_latency, monotonic_time_ns() - sent_ns);
+         }
+         if (state == PN_ACCEPTED) {
+           ++app->acknowledged;
+         } else {
+           ++app->spool_rejected;
+         }
+       }
+       --app->spool_unacked;
+       pn_delivery_settle(d);
+       send_messages(app, pn_delivery_link(d));
+       break;
+     }
+     /* free the in-flight slot and record the time to acknowledgement */
+     uint64_t sent_ns;
+     if (inflight_remove(&app->inflight, delivery_tag_id(d), &sent_ns)) {
+       histogram_record(&app->ack_latency, monotonic_time_ns() - sent_ns);
+     }
      if (pn_delivery_remote_state(d) == PN_ACCEPTED) {
+       pn_delivery_settle(d); /* settle and free d */
        if (++app->acknowledged == app->message_count) {
          printf("%d messages sent and acknowledged\n", app->acknowledged);
+         app->finished = true;
          pn_connection_close(pn_event_connection(event));
          /* Continue handling events till we receive TRANSPORT_CLOSED */
+       } else {
+         /* the window may have been full, send with any remaining credit */
+         send_messages(app, pn_delivery_link(d));
        }
      } else {
        pn_disposition_t* disposition = pn_delivery_remote(d);
        fprintf(stderr, "unexpected delivery state %d\n", (int)pn_delivery_remote_state(d));
-       check_condition(event, pn_disposition_condition(disposition));
+       app->finished = true;
+       check_condition(app, event, pn_disposition_condition(disposition));
        pn_connection_close(pn_event_connection(event));
        exit_code=1;
      }
      break;
    }
 
+   case PN_CONNECTION_WAKE:
+    /* send tick, send the messages that are now due and resume streaming */
+    if (app->sender || app->topic_links) {
+      send_messages(app, app->sender);
+    }
+    break;
+
+   case PN_PROACTOR_TIMEOUT: {
+    /* messages are spooled whether or not the broker is reachable */
+    bool spool_room = app->spool_path && submit_messages(app);
+    bool spooling = spool_room && app->sent < app->message_count;
+    if (reconnect_due(&app->reconnect, monotonic_time_ns())) {
+      connect_broker(app);
+    }
+    if (app->connection) {
+      if (app->rate > 0 || app->stream_path || app->spool_path) {
+        /* wake the connection to send from its own event batch */
+        pn_connection_wake(app->connection);
+        pn_proactor_set_timeout(app->proactor, send_tick_ms(app));
+      }
+    } else if (reconnect_pending(&app->reconnect)) {
+      pn_proactor_set_timeout(app->proactor, spooling ? SEND_TICK_MS : reconnect_wait_ms(&app->reconnect, monotonic_time_ns()));
+    } else if (spooling) {
+      /* keep spooling until every message is submitted or the spool is full */
+      pn_proactor_set_timeout(app->proactor, SEND_TICK_MS);
+    }
+    break;
+   }
+
    case PN_TRANSPORT_CLOSED:
-    check_condition(event, pn_transport_condition(pn_event_transport(event)));
+    check_condition(app, event, pn_transport_condition(pn_event_transport(event)));
+    /* the connection is freed after this event, stop the send tick waking it */
+    app->connection = NULL;
+    app->sender = NULL;
+    if (app->topic_links) {
+      /* the links went with the connection, their queued messages are in the in-flight window */
+      link_cache_reset(&app->links);
+    }
+    if (!app->finished && app->reconnect.max_attempts > 0) {
+      if (reconnect_schedule(&app->reconnect, monotonic_time_ns())) {
+        /* every delivery left unsettled is sent again on the next connection */
+        if (app->spool_path) {
+          app->reconnect.resent += app->spool_unacked;
+          spool_rewind(&app->spool);
+          app->spool_unacked = 0;
+        } else {
+          /* tags still waiting from an earlier drop were never re-added to the in-flight window */
+          size_t waiting = app->resend_count - app->resend_next;
+          memmove(app->resend, app->resend + app->resend_next, waiting * sizeof(int));
+          size_t drained = inflight_drain(&app->inflight, app->resend + waiting);
+          app->reconnect.resent += drained;
+          app->resend_count = waiting + drained;
+          app->resend_next = 0;
+          app->stream_delivery = NULL;
+        }
+        pn_proactor_set_timeout(app->proactor, reconnect_wait_ms(&app->reconnect, monotonic_time_ns()));
+        break;
+      }
+      fprintf(stderr, "Giving up after %d reconnect attempts\n", app->reconnect.max_attempts);
+      exit_code = 1;
+    }
     break;
 
    case PN_CONNECTION_REMOTE_CLOSE:
-    check_condition(event, pn_connection_remote_condition(pn_event_connection(event)));
+    check_condition(app, event, pn_connection_remote_condition(pn_event_connection(event)));
     pn_connection_close(pn_event_connection(event));
     break;
 
    case PN_SESSION_REMOTE_CLOSE:
-    check_condition(event, pn_session_remote_condition(pn_event_session(event)));
+    check_condition(app, event, pn_session_remote_condition(pn_event_session(event)));
     pn_connection_close(pn_event_connection(event));
     break;
 
    case PN_LINK_REMOTE_CLOSE:
    case PN_LINK_REMOTE_DETACH:
-    check_condition(event, pn_link_remote_condition(pn_event_link(event)));
+    if (pn_link_state(pn_event_link(event)) & PN_LOCAL_CLOSED) {
+      /* the broker detached a link the link cache evicted */
+      pn_link_free(pn_event_link(event));
+      break;
+    }
+    check_condition(app, event, pn_link_remote_condition(pn_event_link(event)));
     pn_connection_close(pn_event_connection(event));
     break;
 
@@ -305,10 +913,28 @@ void usage(void) {
     printf("\t-a      The host address [localhost]\n");
     printf("\t-p      The host port [5672]\n");
     printf("\t-c      # of messages to send [10]\n");
-    printf("\t-t      Target address topic [my_topic]\n");
+    printf("\t-t      Target address topic, the topic name pattern with -N [my_topic]\n");
     printf("\t-i      AMQP Container id [producer:<pid>]\n");
     printf("\t-u      Client authentication username []\n");
     printf("\t-P      Client authentication password []\n");
+    printf("\t-e      Send from a pre-encoded message template [false]\n");
+    printf("\t-w      Maximum # of unsettled messages in flight [1024]\n");
+    printf("\t-S      Send messages pre-settled, at-most-once delivery [false]\n");
+    printf("\t-l      Stamp messages with send time and sequence properties for latency, sequences count per connection [false]\n");
+    printf("\t-s      Body size in bytes: <n>, <min>-<max> or @<file> of '<size> [weight]' lines [sequence_<n> text]\n");
+    printf("\t-f      Stream the file as the body of each message, memory mapped []\n");
+    printf("\t-q      Spool file messages are submitted to and sent from, unacknowledged messages survive a restart []\n");
+    printf("\t-Q      Spool size in bytes [67108864]\n");
+    printf("\t-x      Publish over one anonymous relay link, a null target and a 'to' address on each message [false]\n");
+    printf("\t-F      Topics file, one per line, messages go round robin over the topics, a link per topic without -x []\n");
+    printf("\t-N      # of topics generated from the -t pattern, '%%d' is replaced by the topic index [0]\n");
+    printf("\t-k      # of sender links cached with a link per topic, idle links are closed least recently used first [64]\n");
+    printf("\t-G      # of sessions the cached links are spread over [4]\n");
+    printf("\t-M      Bytes of prefixed topic addresses cached [4194304]\n");
+    printf("\t-R      Reconnect attempts after the connection drops, with exponential backoff, 0 to exit on a drop [0]\n");
+    printf("\t-b      Body type for -s: string (amqp-value) or binary (data section) [string]\n");
+    printf("\t-r      Publish rate in messages/sec, 0 for unpaced [0]\n");
+    printf("\t-B      Maximum burst of messages when paced [rate/250]\n");
     printf("\t-h      Displays this message\n");
     exit(0);
 
@@ -328,6 +954,24 @@ void parse_args(int argc, char **argv, app_data_t *app){
     app->message_count = 10;
     app->username = NULL;
     app->password = NULL;
+    app->use_template = false;
+    app->max_inflight = 1024;
+    app->presettled = false;
+    app->stamp = false;
+    app->payload_mode = false;
+    app->binary_body = false;
+    app->rate = 0;
+    app->burst = 0;
+    app->stream_path = NULL;
+    app->spool_path = NULL;
+    app->spool_size = 64 * 1024 * 1024;
+    app->reconnect_attempts = 0;
+    app->anonymous_relay = false;
+    app->topic_file = NULL;
+    app->topic_count = 0;
+    app->address_cache = 4 * 1024 * 1024;
+    app->link_cache_size = 64;
+    app->link_sessions = 4;
     app->amqp_address = "my_topic";
     /* 
      * Set a default amqp topic prefix since broker do not always
@@ -340,7 +984,7 @@ void parse_args(int argc, char **argv, app_data_t *app){
 
     /* command line options */
     opterr = 0;
-    while((c = getopt(argc, argv, "i:a:c:t:p:P:u:h")) != -1) {
+    while((c = getopt(argc, argv, "i:a:c:t:p:P:u:ew:Sr:B:s:f:q:Q:R:b:lxF:N:M:k:G:h")) != -1) {
         switch(c) {
         case 'h': usage(); break;
         case 'c': 
@@ -360,30 +1004,203 @@ void parse_args(int argc, char **argv, app_data_t *app){
         case 'p': app->port = optarg; break;
         case 'P': app->password = optarg; break;
         case 'u': app->username = optarg; break;
+        case 'e': app->use_template = true; break;
+        case 'S': app->presettled = true; break;
+        case 'w':
+            app->max_inflight = atoi(optarg);
+            if (app->max_inflight <= 0) usage();
+            break;
+        case 'l': app->stamp = true; break;
+        case 's':
+            if (payload_parse_size(&app->payload, optarg) != 0) {
+                fprintf(stderr, "Invalid body size: %s\n", optarg);
+                usage();
+            }
+            app->payload_mode = true;
+            break;
+        case 'f': app->stream_path = optarg; break;
+        case 'q': app->spool_path = optarg; break;
+        case 'x': app->anonymous_relay = true; break;
+        case 'F': app->topic_file = optarg; break;
+        case 'N':
+            app->topic_count = atoi(optarg);
+            if (app->topic_count < 0) usage();
+            break;
+        case 'M':
+            if (parse_size(optarg, &app->address_cache) != 0) usage();
+            break;
+        case 'k':
+            app->link_cache_size = atoi(optarg);
+            if (app->link_cache_size <= 0) usage();
+            break;
+        case 'G':
+            app->link_sessions = atoi(optarg);
+            if (app->link_sessions <= 0) usage();
+            break;
+        case 'R':
+            app->reconnect_attempts = atoi(optarg);
+            if (app->reconnect_attempts < 0) usage();
+            break;
+        case 'Q':
+            app->spool_size = strtoul(optarg, NULL, 10);
+            if (app->spool_size == 0) usage();
+            break;
+        case 'b':
+            if (strcmp(optarg, "binary") == 0) {
+                app->binary_body = true;
+            } else if (strcmp(optarg, "string") == 0) {
+                app->binary_body = false;
+            } else {
+                usage();
+            }
+            break;
+        case 'r':
+            app->rate = atoi(optarg);
+            if (app->rate < 0) usage();
+            break;
+        case 'B':
+            app->burst = atoi(optarg);
+            if (app->burst < 0) usage();
+            break;
         default: usage(); break;
         }
     }
+    if (app->stream_path && app->payload_mode) {
+        fprintf(stderr, "Options -f and -s cannot be combined\n");
+        usage();
+    }
+    if (app->stream_path && app->spool_path) {
+        fprintf(stderr, "Options -f and -q cannot be combined\n");
+        usage();
+    }
+    if (app->topic_file && app->topic_count > 0) {
+        fprintf(stderr, "Options -F and -N cannot be combined\n");
+        usage();
+    }
+    /* without the anonymous relay each topic gets its own cached sender link */
+    app->topic_links = (app->topic_file || app->topic_count > 0) && !app->anonymous_relay;
+    if (app->topic_links && (app->stream_path || app->spool_path)) {
+        fprintf(stderr, "Options -F and -N without -x cannot be combined with -f or -q\n");
+        usage();
+    }
 
 }
 
 int main(int argc, char **argv) {
     struct app_data_t app = {0};
-    char addr[PN_MAX_ADDR];
   
     parse_args(argc, argv, &app);
+    if (app.payload_mode && payload_generate(&app.payload, app.binary_body) != 0) {
+        fprintf(stderr, "Unable to allocate message payload of %zu bytes\n", app.payload.max_size);
+        exit(1);
+    }
+    if (app.stream_path) {
+        if (mapped_file_open(&app.stream_file, app.stream_path) != 0) {
+            exit(1);
+        }
+        if (app.stream_file.bytes.size > 0xffffffffu) {
+            /* the data section length is 32 bits */
+            fprintf(stderr, "File too large to send as one message: %s\n", app.stream_path);
+            exit(1);
+        }
+    }
+    if (app.topic_file) {
+        int rc = topic_list_load(&app.topics, app.topic_file);
+        if (rc < 0) {
+            fprintf(stderr, "Unable to read topics: %s\n", app.topic_file);
+            exit(1);
+        } else if (rc > 0) {
+            fprintf(stderr, "%s:%d: expected a single topic shorter than %d bytes\n", app.topic_file, rc, PN_MAX_ADDR);
+            exit(1);
+        } else if (app.topics.count == 0) {
+            fprintf(stderr, "No topics in %s\n", app.topic_file);
+            exit(1);
+        }
+    } else if (app.topic_count > 0) {
+        if (topic_list_generate(&app.topics, app.amqp_address, app.topic_count) != 0) {
+            fprintf(stderr, "Unable to allocate %d topics\n", app.topic_count);
+            exit(1);
+        }
+    } else if (app.anonymous_relay && topic_list_add(&app.topics, app.amqp_address) != 0) {
+        fprintf(stderr, "Unable to allocate topic\n");
+        exit(1);
+    }
+    if (app.topics.count > 0 && addr_cache_init(&app.addresses, app.address_cache) != 0) {
+        fprintf(stderr, "Unable to allocate address cache\n");
+        exit(1);
+    }
+    /* also with -x, a broker without the anonymous relay gets a link per topic */
+    if (app.topics.count > 0 && link_cache_init(&app.links, app.link_cache_size, app.link_sessions, app.presettled) != 0) {
+        fprintf(stderr, "Unable to allocate link cache\n");
+        exit(1);
+    }
+    if (app.use_template || app.payload_mode || app.stream_path) {
+        init_message_template(&app);
+        /* the properties section of each message is sent with its to address set */
+        if (app.topics.count > 0 && msg_template_find_properties(&app.message_template) != 0) {
+            fprintf(stderr, "error locating the properties section in message template\n");
+            exit(1);
+        }
+    }
+    app.rng = 0x2545f4914f6cdd1dULL;
+    if (inflight_init(&app.inflight, app.max_inflight) != 0) {
+        fprintf(stderr, "Unable to allocate in-flight window of %d messages\n", app.max_inflight);
+        exit(1);
+    }
+    app.resend = (int*)calloc(app.max_inflight, sizeof(int));
+    reconnect_init(&app.reconnect, app.reconnect_attempts);
+    if (app.rate > 0) {
+        pacer_init(&app.pacer, app.rate, app.burst);
+    }
+    if (app.spool_path) {
+        if (spool_open(&app.spool, app.spool_path, app.spool_size) != 0) {
+            fprintf(stderr, "Unable to open spool: %s\n", app.spool_path);
+            exit(1);
+        }
+        if (app.spool.recovered > 0) {
+            printf("%llu spooled messages from a previous run are sent first\n", (unsigned long long)app.spool.recovered);
+        }
+    }
     
     app.proactor = pn_proactor();
-    pn_proactor_addr(addr, sizeof(addr), app.host, app.port);
-    /* Initial Sasl transport for authentication */
-    pn_transport_t *pnt = pn_transport();
-    pn_sasl_t *sasl = pn_sasl(pnt);
-    pn_sasl_set_allow_insecure_mechs(sasl, true);
-    
-    pn_proactor_connect2(app.proactor, NULL, pnt, addr);
+    pn_proactor_addr(app.addr, sizeof(app.addr), app.host, app.port);
+    connect_broker(&app);
+    if (app.rate > 0 || app.stream_path || app.spool_path) {
+        /* start the send tick */
+        pn_proactor_set_timeout(app.proactor, SEND_TICK_MS);
+    }
     run(&app);
+    const uint64_t end_ns = monotonic_time_ns();
+    histogram_print(&app.ack_latency, "ack latency", stdout);
+    if (app.rate > 0) {
+        histogram_print(&app.send_lag, "send lag", stdout);
+    }
+    if (app.reconnect_attempts > 0) {
+        reconnect_print(&app.reconnect, stdout);
+    }
+    if (app.topics.count > 0) {
+        topic_list_print(&app.topics, app.first_send_ns > 0 ? end_ns - app.first_send_ns : 0, stdout);
+        addr_cache_print(&app.addresses, stdout);
+        if (app.topic_links) {
+            link_cache_print(&app.links, stdout);
+        }
+    }
+    if (app.spool_path) {
+        spool_print(&app.spool, stdout);
+        spool_close(&app.spool);
+    }
     pn_proactor_free(app.proactor);
     /* free app data */
     free(app.message_buffer.start);
+    msg_template_free(&app.message_template);
+    inflight_free(&app.inflight);
+    free(app.resend);
+    conn_props_free(&app.conn_props);
+    topic_list_free(&app.topics);
+    addr_cache_free(&app.addresses);
+    link_cache_free(&app.links);
+    payload_free(&app.payload);
+    mapped_file_close(&app.stream_file);
     str_free(app.container_id);
     str_free(app.amqp_topic_prefix);
     return exit_code;
@@ -35,12 +35,24 @@
 #include <proton/transport.h>
 #include <proton/sasl.h>
 
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include "util.h"
+#include "stamp.h"
+#include "recv_pool.h"
+#include "msg_view.h"
+#include "sink.h"
+#include "ack_batch.h"
+#include "credit.h"
+#include "workq.h"
+#include "journal.h"
+#include "dedup.h"
 
 typedef struct app_data_t {
   const char *host, *port;
@@ -48,16 +60,114 @@ typedef struct app_data_t {
   const char *amqp_address;
   const char *container_id;
   int message_count;
+  int threads;
+  int connections;
+  const char *output;          /* sink specification, see sink_open */
+  sink_t sink;
+  bool lazy_view;              /* read stamps and body in place instead of decoding */
+  int stats_interval;          /* seconds between latency reports, 0 for exit only */
+  int ack_batch;               /* deliveries settled together, 1 to settle each */
+  int ack_window;              /* milliseconds a delivery may be held unsettled */
+  int credit_window;           /* maximum link credit */
+  size_t credit_bytes;         /* message bytes credit may be outstanding for */
+  int credit_latency;          /* milliseconds to consume the credited messages */
+  int workers;                 /* worker threads processing messages, 0 to process on the event loop */
+  const char *lane_key;        /* 'subject' or an application property keeping order per key, NULL for none */
+  int links;                   /* receiver links per connection, each on its own session */
+  bool shared;                 /* one message count and credit budget over all links */
+  const char *journal_path;    /* journal segment path, NULL to accept without journaling */
+  size_t journal_segment;      /* journal segment size */
+  size_t dedup_window;         /* recent message keys checked for redeliveries, 0 for none */
+  const char *dedup_key;       /* 'message-id' or an application property identifying a message */
 
   pn_proactor_t *proactor;
-  int received;
-  bool finished;
-  pn_rwbytes_t msgin;       /* Partially received message */
+  struct conn_data_t *conns;
+  pthread_mutex_t conns_lock;  /* guards conn_data_t.connection for the timer and workers */
+  workq_t queue;               /* messages waiting for a worker */
+  struct worker_t *worker_threads;
+  uint64_t next_lane_report_ns;
+  atomic_int outstanding;      /* credit granted and not yet accepted over all links, when shared */
+  atomic_int received;         /* messages accepted over all links, when shared */
+  dedup_t dedup;               /* keys of recently received messages over all connections */
+  pthread_mutex_t dedup_lock;  /* guards dedup, connections check it from their own event batches */
 } app_data_t;
 
-static const int BATCH = 1000; /* Batch size for unlimited receive */
+/*
+ * A received message handed to a worker. Items live in the ring of their
+ * connection in delivery order, the worker only sets the status and done.
+ */
+typedef struct work_item_t {
+  struct conn_data_t *conn;
+  pn_delivery_t *delivery;  /* only touched from the connection's event batch */
+  recv_buffer_t buffer;
+  uint64_t key;             /* dedup key remembered once accepted, 0 for none */
+  bool duplicate;           /* accepted without processing or counting toward -c */
+  int status;               /* 0 if processed, 1 on a decode error */
+  atomic_bool done;
+} work_item_t;
 
-static int exit_code = 0;
+/*
+ * A worker thread. With a lane key each worker is a lane with its own
+ * queue, messages with the same key always go to the same lane and are
+ * processed in order, otherwise all workers share the app queue.
+ */
+typedef struct worker_t {
+  app_data_t *app;
+  pthread_t thread;
+  workq_t *queue;           /* the queue this worker takes messages from */
+  workq_t lane;             /* lane queue when keyed */
+  atomic_uint_fast64_t submitted;  /* lane metrics */
+  atomic_uint_fast64_t processed;
+  atomic_uint_fast64_t max_depth;
+  stamp_stats_t stamps;     /* end to end latency of the messages this worker processed */
+} worker_t;
+
+/*
+ * Per receiver link state, owned by the link's connection.
+ */
+typedef struct link_data_t {
+  struct conn_data_t *conn;
+  char name[32];
+  char label[PN_MAX_ADDR + 32]; /* connection and link name in reports */
+  pn_link_t *link;          /* NULL once the transport is closed */
+  credit_t credit;          /* adaptive link credit */
+  int outstanding;          /* credit granted and not yet accepted */
+  int pending;              /* messages with the workers */
+  uint64_t received;
+  uint64_t first_ns;        /* first and last message, for the average rate */
+  uint64_t last_ns;
+  uint64_t report_received; /* received at the last periodic report */
+  uint64_t report_ns;
+} link_data_t;
+
+/*
+ * Per connection state. The proactor serializes events for a connection,
+ * so only the thread handling the current event batch touches it.
+ */
+typedef struct conn_data_t {
+  app_data_t *app;
+  char container_id[PN_MAX_ADDR];
+  pn_connection_t *connection; /* NULL once the transport is closed */
+  link_data_t *links;
+  atomic_int outstanding;   /* credit granted and not yet accepted over the links, when not shared */
+  atomic_int received;      /* messages accepted over the links, when not shared */
+  recv_buffer_t msgin;      /* Partially received message */
+  recv_pool_t pool;         /* receive buffers reused across deliveries */
+  stamp_stats_t stamps;     /* end to end latency of stamped messages */
+  ack_batch_t acks;         /* accepted deliveries waiting to be settled */
+  journal_t journal;        /* received messages made durable before they are accepted */
+  uint64_t next_report_ns;  /* when the next periodic report is due */
+  work_item_t *work;        /* ring of messages handed to workers, in delivery order */
+  size_t work_capacity;
+  size_t work_head;         /* oldest message not yet accepted */
+  size_t work_tail;
+  atomic_bool wake_pending; /* a worker has woken the connection to accept completed work */
+  int exit_code;
+} conn_data_t;
+
+#define RECV_POOL_IDLE 4 /* idle receive buffers kept per connection */
+
+#define CREDIT_REBALANCE_MS 20 /* how often links sharing a budget pick up credit the others released */
 
 extern int optind;
 extern char* optarg;
@@ -67,34 +177,402 @@ extern int opterr;
 #define str_free(strptr) free((void *)strptr)
 
 
-static void check_condition(pn_event_t *e, pn_condition_t *cond) {
+static void check_condition(conn_data_t *conn, pn_event_t *e, pn_condition_t *cond) {
   if (pn_condition_is_set(cond)) {
     fprintf(stderr, "%s: %s: %s\n", pn_event_type_name(pn_event_type(e)),
             pn_condition_get_name(cond), pn_condition_get_description(cond));
     pn_connection_close(pn_event_connection(e));
-    exit_code = 1;
+    if (conn) conn->exit_code = 1;
   }
 }
 
-static void decode_message(pn_rwbytes_t data) {
+/*
+ * Fast path for -v: find the sections in the received bytes and read only
+ * the stamps and the body from them, without decoding a pn_message_t.
+ */
+static int view_message(app_data_t *app, stamp_stats_t *stamps, pn_rwbytes_t data) {
+  const uint64_t now = realtime_ns();
+  msg_view_t view;
+  int err = msg_view_parse(&view, pn_bytes(data.size, data.start));
+  if (!err) {
+    /* Record end to end latency if the sender stamped the message */
+    uint64_t sent_ns, sequence;
+    if (stamp_read_view(&view, &sent_ns, &sequence)) {
+      stamp_record(stamps, sent_ns, sequence, now);
+    }
+    if (sink_wants_text(&app->sink)) {
+      /* Print the body straight from the receive buffer */
+      pn_bytes_t body;
+      char line[64];
+      struct iovec iov[3] = { { "\"", 1 }, { NULL, 0 }, { "\"\n", 2 } };
+      switch (msg_view_body(&view, &body)) {
+      case PN_STRING:
+      case PN_SYMBOL:
+        iov[1].iov_base = (void*)body.start;
+        iov[1].iov_len = body.size;
+        sink_text(&app->sink, iov, 3);
+        break;
+      case PN_BINARY:
+        iov[0].iov_base = line;
+        iov[0].iov_len = snprintf(line, sizeof(line), "<%zu bytes binary>\n", body.size);
+        sink_text(&app->sink, iov, 1);
+        break;
+      default:
+        iov[0].iov_base = "<body not inspected>\n";
+        iov[0].iov_len = strlen(iov[0].iov_base);
+        sink_text(&app->sink, iov, 1);
+        break;
+      }
+    } else {
+      sink_message(&app->sink, pn_bytes(data.size, data.start));
+    }
+  } else {
+    fprintf(stderr, "view_message: %s\n", pn_code(err));
+    return 1;
+  }
+  return 0;
+}
+
+static int decode_message(app_data_t *app, stamp_stats_t *stamps, pn_rwbytes_t data) {
+  const uint64_t now = realtime_ns();
   pn_message_t *m = pn_message();
   int err = pn_message_decode(m, data.start, data.size);
   if (!err) {
-    /* Print the decoded message */
-    pn_string_t *s = pn_string(NULL);
-    pn_inspect(pn_message_body(m), s);
-    printf("%s\n", pn_string_get(s));
-    pn_free(s);
+    /* Record end to end latency if the sender stamped the message */
+    uint64_t sent_ns, sequence;
+    if (stamp_read(m, &sent_ns, &sequence)) {
+      stamp_record(stamps, sent_ns, sequence, now);
+    }
+    if (sink_wants_text(&app->sink)) {
+      /* Print the decoded message */
+      pn_string_t *s = pn_string(NULL);
+      pn_inspect(pn_message_body(m), s);
+      struct iovec iov[2] = { { (void*)pn_string_get(s), pn_string_size(s) }, { "\n", 1 } };
+      sink_text(&app->sink, iov, 2);
+      pn_free(s);
+    } else {
+      sink_message(&app->sink, pn_bytes(data.size, data.start));
+    }
     pn_message_free(m);
-    free(data.start);
   } else {
     fprintf(stderr, "decode_message: %s\n", pn_code(err));
-    exit_code = 1;
+    return 1;
   }
+  return 0;
+}
+
+/* Decode and output a received message, returns 0 on success */
+static int process_message(app_data_t *app, stamp_stats_t *stamps, pn_rwbytes_t data) {
+  return app->lazy_view ? view_message(app, stamps, data) : decode_message(app, stamps, data);
+}
+
+/*
+ * Wake every open connection so it reports its own statistics.
+ * Returns true while a connection is still open and the stats timer is needed.
+ */
+static bool wake_connections(app_data_t* app) {
+  bool open = false;
+  pthread_mutex_lock(&app->conns_lock);
+  for (int i = 0; i < app->connections; i++) {
+    if (app->conns[i].connection) {
+      pn_connection_wake(app->conns[i].connection);
+      open = true;
+    }
+  }
+  pthread_mutex_unlock(&app->conns_lock);
+  return open;
+}
+
+/* True when several links draw credit from one budget */
+static bool shares_budget(app_data_t *app) {
+  return app->links > 1 || app->shared;
+}
+
+/* The budget a link draws credit from, every link's when shared, else its connection's */
+static atomic_int *outstanding_budget(conn_data_t *conn) {
+  return conn->app->shared ? &conn->app->outstanding : &conn->outstanding;
+}
+
+/* The message count a link adds to, every link's when shared, else its connection's */
+static atomic_int *received_counter(conn_data_t *conn) {
+  return conn->app->shared ? &conn->app->received : &conn->received;
+}
+
+/*
+ * Tops the link credit up to its adaptive window. The grant is drawn from
+ * the budget the link shares and never goes past the messages still expected.
+ */
+static void flow_credit(link_data_t *link) {
+  conn_data_t *conn = link->conn;
+  app_data_t *app = conn->app;
+  /* messages still with the workers count against the window */
+  const int want = credit_top_up(&link->credit, pn_link_credit(link->link)) - link->pending;
+  if (want <= 0) {
+    return;
+  }
+  atomic_int *outstanding = outstanding_budget(conn);
+  int limit = app->shared ? app->credit_window : INT_MAX;
+  if (app->message_count > 0 && app->message_count - atomic_load(received_counter(conn)) < limit) {
+    limit = app->message_count - atomic_load(received_counter(conn));
+  }
+  /* reserve the grant, links on other connections draw from a shared budget concurrently */
+  int current = atomic_load(outstanding);
+  int grant;
+  do {
+    grant = want < limit - current ? want : limit - current;
+    if (grant <= 0) {
+      return;
+    }
+  } while (!atomic_compare_exchange_weak(outstanding, &current, current + grant));
+  link->outstanding += grant;
+  pn_link_flow(link->link, grant);
+}
+
+/*
+ * Accepts a processed message, then closes at the message count or grants more credit.
+ * Its dedup key enters the window once the delivery is accepted. A duplicate
+ * is accepted the same way but does not count toward the message count.
+ */
+static void complete_message(conn_data_t *conn, pn_delivery_t *d, const uint64_t key, const bool duplicate) {
+  app_data_t *app = conn->app;
+  link_data_t *link = (link_data_t*)pn_link_get_context(pn_delivery_link(d));
+  const uint64_t now = monotonic_time_ns();
+  /* Accept the delivery, settled now or with the rest of its batch */
+  ack_batch_add(&conn->acks, d, key, !duplicate, now);
+  if (link->received++ == 0) {
+    link->first_ns = now;
+  }
+  link->last_ns = now;
+  if (duplicate) {
+    atomic_fetch_sub(outstanding_budget(conn), 1);
+    link->outstanding--;
+    flow_credit(link);
+    return;
+  }
+  /* count before releasing the credit so a concurrent flow_credit never over grants */
+  const int received = atomic_fetch_add(received_counter(conn), 1) + 1;
+  atomic_fetch_sub(outstanding_budget(conn), 1);
+  link->outstanding--;
+  if (app->message_count > 0 && received >= app->message_count) {
+    /* a failed commit releases the batch and takes it back out of the count */
+    ack_batch_flush(&conn->acks);
+  }
+  if (app->message_count > 0 && atomic_load(received_counter(conn)) >= app->message_count) {
+    if (received == app->message_count) {
+      printf("%d messages received\n", received);
+    }
+    pn_connection_close(conn->connection);
+    if (app->shared) {
+      /* the other connections close when they see the count reached */
+      wake_connections(app);
+    }
+  } else {
+    /* see if more credit is needed */
+    flow_credit(link);
+  }
+}
+
+/* Prints a link's throughput since its last report, or its average over the run at exit */
+static void print_link(link_data_t *link, uint64_t now, bool final, FILE *out) {
+  if (final) {
+    const double seconds = (link->last_ns - link->first_ns) / 1e9;
+    fprintf(out, "link %s: received=%llu rate=%.0f msg/s\n", link->label, (unsigned long long)link->received,
+            seconds > 0 ? link->received / seconds : 0.0);
+  } else {
+    const double seconds = (now - link->report_ns) / 1e9;
+    fprintf(out, "link %s: received=%llu rate=%.0f msg/s\n", link->label, (unsigned long long)link->received,
+            seconds > 0 ? (link->received - link->report_received) / seconds : 0.0);
+    link->report_received = link->received;
+    link->report_ns = now;
+  }
+}
+
+/*
+ * Worker thread: processes messages off the event loop, then wakes their
+ * connection so they are accepted in delivery order from its event batch.
+ */
+static void* work_run(void *arg) {
+  worker_t *worker = (worker_t*)arg;
+  app_data_t *app = worker->app;
+  work_item_t *item;
+  while ((item = (work_item_t*)workq_pop_wait(worker->queue)) != NULL) {
+    conn_data_t *conn = item->conn;
+    item->status = process_message(app, &worker->stamps, pn_rwbytes(item->buffer.size, item->buffer.start));
+    atomic_fetch_add(&worker->processed, 1);
+    atomic_store_explicit(&item->done, true, memory_order_release);
+    /* one wake covers every item completed before the connection drains */
+    if (!atomic_exchange(&conn->wake_pending, true)) {
+      pthread_mutex_lock(&app->conns_lock);
+      if (conn->connection) {
+        pn_connection_wake(conn->connection);
+      }
+      pthread_mutex_unlock(&app->conns_lock);
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Hashes the lane key read in place from the encoded message.
+ * Returns false if the message has no key.
+ */
+static bool message_key_hash(app_data_t *app, const recv_buffer_t *buffer, uint64_t *hash) {
+  msg_view_t view;
+  pn_bytes_t value, key;
+  uint64_t number;
+  if (msg_view_parse(&view, pn_bytes(buffer->size, buffer->start)) != 0) {
+    return false;
+  }
+  if (strcmp(app->lane_key, "subject") == 0) {
+    if (msg_view_list_get(view.properties, MSG_VIEW_SUBJECT, &value) != 0) return false;
+  } else if (msg_view_map_get(view.application_properties, app->lane_key, strlen(app->lane_key), &value) != 0) {
+    return false;
+  }
+  if (msg_view_get_bytes(value, &key) == 0) {
+    *hash = hash_bytes(key.start, key.size);
+  } else if (msg_view_get_ulong(value, &number) == 0) {
+    /* integers hash by value whatever width they were encoded with */
+    *hash = hash_bytes((const char*)&number, sizeof(number));
+  } else if (value.size > 0 && (unsigned char)value.start[0] != 0x40) {
+    *hash = hash_bytes(value.start, value.size);
+  } else {
+    return false; /* null key */
+  }
+  return true;
+}
+
+/* Picks the queue for a message, its key's lane when keyed */
+static workq_t *work_queue(app_data_t *app, const recv_buffer_t *buffer, size_t sequence) {
+  if (!app->lane_key) {
+    return &app->queue;
+  }
+  uint64_t hash;
+  /* messages without a key have no order to keep, spread them round robin */
+  worker_t *lane = &app->worker_threads[(message_key_hash(app, buffer, &hash) ? hash : sequence) % app->workers];
+  uint_fast64_t depth = atomic_fetch_add(&lane->submitted, 1) + 1 - atomic_load(&lane->processed);
+  if (depth > atomic_load(&lane->max_depth)) {
+    atomic_store(&lane->max_depth, depth);  /* a racing update may be lost, it is only a metric */
+  }
+  return &lane->lane;
+}
+
+/* Prints the lane depths and how unevenly the keys spread over the lanes */
+static void print_lanes(app_data_t *app, FILE *out) {
+  uint64_t total = 0, busiest = 0;
+  for (int i = 0; i < app->workers; i++) {
+    worker_t *lane = &app->worker_threads[i];
+    uint64_t processed = atomic_load(&lane->processed);
+    fprintf(out, "lane %d: processed=%llu depth=%llu max depth=%llu\n", i, (unsigned long long)processed,
+            (unsigned long long)(atomic_load(&lane->submitted) - processed),
+            (unsigned long long)atomic_load(&lane->max_depth));
+    total += processed;
+    busiest = processed > busiest ? processed : busiest;
+  }
+  /* 1.0 is an even spread, hot keys push the busiest lane above the mean */
+  fprintf(out, "lanes: skew=%.2f (busiest lane / mean)\n", total ? (double)busiest * app->workers / total : 0.0);
+}
+
+/*
+ * Checks a message key against the window shared by every connection, so
+ * a message the broker redelivers on another connection is still spotted.
+ */
+static bool is_duplicate(app_data_t *app, const uint64_t key) {
+  pthread_mutex_lock(&app->dedup_lock);
+  const bool duplicate = dedup_seen(&app->dedup, key);
+  pthread_mutex_unlock(&app->dedup_lock);
+  return duplicate;
+}
+
+/* ack_batch accepted callback, remembers the key of an accepted message in the shared window */
+static void record_key(void *context, const uint64_t key) {
+  app_data_t *app = (app_data_t*)context;
+  pthread_mutex_lock(&app->dedup_lock);
+  dedup_record(&app->dedup, key);
+  pthread_mutex_unlock(&app->dedup_lock);
+}
+
+/* ack_batch released callback, messages whose commit failed are redelivered and count again then */
+static void uncount_released(void *context, const int count) {
+  conn_data_t *conn = (conn_data_t*)context;
+  atomic_fetch_sub(received_counter(conn), count);
+  /* credit held back at the message count is needed for the redeliveries */
+  for (int i = 0; i < conn->app->links; i++) {
+    if (conn->links[i].link) {
+      flow_credit(&conn->links[i]);
+    }
+  }
+}
+
+/*
+ * Hands a complete message to the workers, it is accepted once processed.
+ * A duplicate needs no processing and is added to the ring already done,
+ * so it is still accepted in delivery order.
+ */
+static void submit_work(conn_data_t *conn, pn_delivery_t *d, const uint64_t key, const bool duplicate) {
+  if (conn->work_tail - conn->work_head == conn->work_capacity) {
+    /* credit bounds the messages in flight to the ring size, the peer overran it */
+    fprintf(stderr, "More messages in flight than credit granted\n");
+    pn_connection_close(pn_session_connection(pn_link_session(pn_delivery_link(d))));
+    conn->exit_code = 1;
+    return;
+  }
+  work_item_t *item = &conn->work[conn->work_tail++ % conn->work_capacity];
+  item->conn = conn;
+  item->delivery = d;
+  item->key = key;
+  item->duplicate = duplicate;
+  item->buffer = conn->msgin;
+  item->status = 0;
+  atomic_store_explicit(&item->done, duplicate, memory_order_relaxed);
+  conn->msgin = (recv_buffer_t){ NULL, 0, 0 };
+  ((link_data_t*)pn_link_get_context(pn_delivery_link(d)))->pending++;
+  if (duplicate) {
+    return;
+  }
+  /* a queue holds every connection's ring, it cannot be full */
+  workq_push(work_queue(conn->app, &item->buffer, conn->work_tail), item);
+}
+
+/* Accepts the processed messages at the head of the ring, stopping at the first still in work */
+static void drain_work(conn_data_t *conn) {
+  atomic_store(&conn->wake_pending, false);
+  while (conn->work_head != conn->work_tail) {
+    work_item_t *item = &conn->work[conn->work_head % conn->work_capacity];
+    if (!atomic_load_explicit(&item->done, memory_order_acquire)) {
+      break;
+    }
+    conn->work_head++;
+    ((link_data_t*)pn_link_get_context(pn_delivery_link(item->delivery)))->pending--;
+    recv_pool_put(&conn->pool, &item->buffer);
+    if (item->status != 0) {
+      conn->exit_code = 1;
+      pn_connection_close(conn->connection);
+      return;
+    }
+    complete_message(conn, item->delivery, item->key, item->duplicate);
+  }
+}
+
+/*
+ * The proactor timer ticks at the shortest of the ack window when batching,
+ * the credit rebalance when links share a budget and the report interval.
+ * Returns INT_MAX when no timer is needed.
+ */
+static int timer_interval_ms(app_data_t* app) {
+  int interval = app->stats_interval > 0 ? app->stats_interval * 1000 : INT_MAX;
+  if (app->ack_batch > 1 && app->ack_window < interval) {
+    interval = app->ack_window;
+  }
+  if (shares_budget(app) && CREDIT_REBALANCE_MS < interval) {
+    interval = CREDIT_REBALANCE_MS;
+  }
+  return interval;
 }
 
 /* Return true to continue, false to exit */
 static bool handle(app_data_t* app, pn_event_t* event) {
+  pn_connection_t* pnc = pn_event_connection(event);
+  conn_data_t* conn = pnc ? (conn_data_t*)pn_connection_get_context(pnc) : NULL;
   switch (pn_event_type(event)) {
 
    case PN_CONNECTION_INIT: {
@@ -104,25 +582,29 @@ static bool handle(app_data_t* app, pn_event_t* event) {
         pn_connection_set_user(c, app->username);
         pn_connection_set_password(c, app->password);
      }
-     pn_session_t* s = pn_session(c);
-     pn_connection_set_container(c, app->container_id);
+     pn_connection_set_container(c, conn->container_id);
      pn_connection_open(c);
-     pn_session_open(s);
-     {
-     pn_link_t* l = pn_receiver(s, "my_receiver");
-     /*
-      * Set the terminus address to the target destination or node
-      * on the remote broker.
-      *
-      * The Solace Pubsub+ broker treats all un-prefixed termini
-      * addresses as queues, alternatively adding the 'queue://'
-      * prefix to the terminus address will receive messages from
-      * a queue as well.
-      * */
-     pn_terminus_set_address(pn_link_source(l), app->amqp_address);
-     pn_link_open(l);
-     /* cannot receive without granting credit: */
-     pn_link_flow(l, app->message_count ? app->message_count : BATCH);
+     /* links on separate sessions so each has its own session window */
+     for (int i = 0; i < app->links; i++) {
+       link_data_t *link = &conn->links[i];
+       pn_session_t* s = pn_session(c);
+       pn_session_open(s);
+       pn_link_t* l = pn_receiver(s, link->name);
+       link->link = l;
+       pn_link_set_context(l, link);
+       /*
+        * Set the terminus address to the target destination or node
+        * on the remote broker.
+        *
+        * The Solace Pubsub+ broker treats all un-prefixed termini
+        * addresses as queues, alternatively adding the 'queue://'
+        * prefix to the terminus address will receive messages from
+        * a queue as well.
+        * */
+       pn_terminus_set_address(pn_link_source(l), app->amqp_address);
+       pn_link_open(l);
+       /* cannot receive without granting credit: */
+       flow_credit(link);
      }
    } break;
 
@@ -132,65 +614,155 @@ static bool handle(app_data_t* app, pn_event_t* event) {
      if (pn_delivery_readable(d)) {
        pn_link_t *l = pn_delivery_link(d);
        size_t size = pn_delivery_pending(d);
-       pn_rwbytes_t* m = &app->msgin; /* Append data to incoming message buffer */
+       recv_buffer_t* m = &conn->msgin; /* Append data to incoming message buffer */
        int recv;
-       size_t oldsize = m->size;
-       m->size += size;
-       m->start = (char*)realloc(m->start, m->size);
-       recv = pn_link_recv(l, m->start + oldsize, m->size);
+       if (recv_pool_reserve(&conn->pool, m, m->size + size) != 0) {
+         fprintf(stderr, "Unable to allocate receive buffer of %zu bytes\n", m->size + size);
+         exit(1);
+       }
+       recv = pn_link_recv(l, m->start + m->size, m->capacity - m->size);
+       if (recv > 0) {
+         m->size += recv;
+       }
        if (recv == PN_ABORTED) {
          fprintf(stderr, "Message aborted\n");
          m->size = 0;           /* Forget the data we accumulated */
          pn_delivery_settle(d); /* Free the delivery so we can receive the next message */
-         pn_link_flow(l, 1);    /* Replace credit for aborted message */
+         /* release the aborted message's credit and top up within the window and budget */
+         link_data_t *link = (link_data_t*)pn_link_get_context(l);
+         atomic_fetch_sub(outstanding_budget(conn), 1);
+         link->outstanding--;
+         flow_credit(link);
        } else if (recv < 0 && recv != PN_EOS) {        /* Unexpected error */
          pn_condition_format(pn_link_condition(l), "broker", "PN_DELIVERY error: %s", pn_code(recv));
          pn_link_close(l);               /* Unexpected error, close the link */
        } else if (!pn_delivery_partial(d)) { /* Message is complete */
-         decode_message(*m);
-         *m = pn_rwbytes_null;  /* Reset the buffer for the next message*/
-         /* Accept the delivery */
-         pn_delivery_update(d, PN_ACCEPTED);
-         pn_delivery_settle(d);  /* settle and free d */
-         if (app->message_count == 0) {
-           /* receive forever - see if more credit is needed */
-           if (pn_link_credit(l) < BATCH/2) {
-             /* Grant enough credit to bring it up to BATCH: */
-             pn_link_flow(l, BATCH - pn_link_credit(l));
+         /* a redelivered message is accepted again without being journaled or processed */
+         const uint64_t key = app->dedup_window > 0 ? dedup_key(&app->dedup, pn_bytes(m->size, m->start)) : 0;
+         if (app->dedup_window > 0 && is_duplicate(app, key)) {
+           credit_record(&((link_data_t*)pn_link_get_context(l))->credit, m->size, monotonic_time_ns());
+           if (app->workers > 0) {
+             /* behind the messages still with the workers */
+             submit_work(conn, d, 0, true);
+             drain_work(conn);
+             break;
            }
-         } else if (++app->received >= app->message_count) {
-           pn_session_t *ssn = pn_link_session(l);
-           printf("%d messages received\n", app->received);
-           pn_link_close(l);
-           pn_session_close(ssn);
-           pn_connection_close(pn_session_connection(ssn));
+           recv_pool_put(&conn->pool, m);
+           complete_message(conn, d, 0, true);
+           break;
+         }
+         /* store the message as received, it is committed before its batch is accepted */
+         if (app->journal_path && journal_append(&conn->journal, pn_bytes(m->size, m->start)) != 0) {
+           fprintf(stderr, "Unable to journal a message of %zu bytes\n", m->size);
+           conn->exit_code = 1;
+           pn_connection_close(pn_event_connection(event));
+           break;
          }
+         credit_record(&((link_data_t*)pn_link_get_context(l))->credit, m->size, monotonic_time_ns());
+         if (app->workers > 0) {
+           submit_work(conn, d, key, false);
+           break;
+         }
+         if (process_message(app, &conn->stamps, pn_rwbytes(m->size, m->start)) != 0) {
+           conn->exit_code = 1;
+         }
+         recv_pool_put(&conn->pool, m);  /* Reuse the buffer for the next message */
+         if (conn->exit_code != 0) {
+           pn_connection_close(pn_event_connection(event));
+           break;
+         }
+         complete_message(conn, d, key, false);
        }
      }
      break;
    }
 
+   case PN_CONNECTION_WAKE: {
+    /* worker completion or timer tick, accept processed messages in order */
+    if (app->workers > 0) {
+      drain_work(conn);
+    }
+    /* settle held deliveries and report from the connection's own event batch */
+    uint64_t now = monotonic_time_ns();
+    ack_batch_flush_due(&conn->acks, now);
+    if (app->shared && app->message_count > 0 && atomic_load(&app->received) >= app->message_count) {
+      /* another connection received the last message */
+      ack_batch_flush(&conn->acks);
+      pn_connection_close(conn->connection);
+      break;
+    }
+    if (shares_budget(app)) {
+      /* links that found the budget spent pick up what the others released since */
+      for (int i = 0; i < app->links; i++) {
+        flow_credit(&conn->links[i]);
+      }
+    }
+    if (app->stats_interval > 0 && now >= conn->next_report_ns) {
+      stamp_print(&conn->stamps, conn->container_id, stdout);
+      for (int i = 0; i < app->links; i++) {
+        credit_print(&conn->links[i].credit, conn->links[i].label, stdout);
+        print_link(&conn->links[i], now, false, stdout);
+      }
+      conn->next_report_ns = now + (uint64_t)app->stats_interval * 1000000000;
+    }
+    break;
+   }
+
+   case PN_PROACTOR_TIMEOUT:
+    if (app->lane_key && app->stats_interval > 0 && monotonic_time_ns() >= app->next_lane_report_ns) {
+      print_lanes(app, stdout);
+      app->next_lane_report_ns = monotonic_time_ns() + (uint64_t)app->stats_interval * 1000000000;
+    }
+    if (wake_connections(app)) {
+      pn_proactor_set_timeout(app->proactor, timer_interval_ms(app));
+    }
+    break;
+
    case PN_TRANSPORT_CLOSED:
-    check_condition(event, pn_transport_condition(pn_event_transport(event)));
+    check_condition(conn, event, pn_transport_condition(pn_event_transport(event)));
+    if (conn) {
+      /* the connection is freed after this event, stop the stats timer waking it */
+      bool open = false;
+      pthread_mutex_lock(&app->conns_lock);
+      conn->connection = NULL;
+      ack_batch_discard(&conn->acks);
+      for (int i = 0; i < app->links; i++) {
+        /* give the credit the closed links held back to the budget */
+        atomic_fetch_sub(outstanding_budget(conn), conn->links[i].outstanding);
+        conn->links[i].outstanding = 0;
+        conn->links[i].link = NULL;
+      }
+      for (int i = 0; i < app->connections; i++) {
+        open = open || app->conns[i].connection != NULL;
+      }
+      pthread_mutex_unlock(&app->conns_lock);
+      if (timer_interval_ms(app) != INT_MAX && !open) {
+        /* last connection closed, don't hold the proactor open until the next tick */
+        pn_proactor_cancel_timeout(app->proactor);
+      }
+    }
     break;
 
    case PN_CONNECTION_REMOTE_CLOSE:
-    check_condition(event, pn_connection_remote_condition(pn_event_connection(event)));
+    check_condition(conn, event, pn_connection_remote_condition(pn_event_connection(event)));
     pn_connection_close(pn_event_connection(event));
     break;
 
    case PN_SESSION_REMOTE_CLOSE:
-    check_condition(event, pn_session_remote_condition(pn_event_session(event)));
+    check_condition(conn, event, pn_session_remote_condition(pn_event_session(event)));
     pn_connection_close(pn_event_connection(event));
     break;
 
    case PN_LINK_REMOTE_CLOSE:
    case PN_LINK_REMOTE_DETACH:
-    check_condition(event, pn_link_remote_condition(pn_event_link(event)));
+    check_condition(conn, event, pn_link_remote_condition(pn_event_link(event)));
     pn_connection_close(pn_event_connection(event));
     break;
 
    case PN_PROACTOR_INACTIVE:
+   case PN_PROACTOR_INTERRUPT:
+    /* all connections are closed, interrupt the next thread so it stops too */
+    pn_proactor_interrupt(app->proactor);
     return false;
     break;
 
@@ -200,18 +772,48 @@ static bool handle(app_data_t* app, pn_event_t* event) {
     return true;
 }
 
-void run(app_data_t *app) {
+void* run(void *arg) {
+  app_data_t *app = (app_data_t*)arg;
+  bool finished = false;
   /* Loop and handle events */
   do {
     pn_event_batch_t *events = pn_proactor_wait(app->proactor);
     pn_event_t *e;
     for (e = pn_event_batch_next(events); e; e = pn_event_batch_next(events)) {
-      if (!handle(app, e) || exit_code != 0) {
-        return;
+      if (!handle(app, e)) {
+        finished = true;
       }
     }
     pn_proactor_done(app->proactor, events);
-  } while(true);
+  } while(!finished);
+  return NULL;
+}
+
+/* Run the proactor event loop on app->threads threads, including the calling thread */
+void run_threads(app_data_t *app) {
+  for (int i = 0; i < app->workers; i++) {
+    app->worker_threads[i].app = app;
+    /* a worker sees one connection's messages in order only when it is the only worker */
+    app->worker_threads[i].stamps.unordered = app->workers > 1 || app->connections > 1;
+    app->worker_threads[i].queue = app->lane_key ? &app->worker_threads[i].lane : &app->queue;
+    pthread_create(&app->worker_threads[i].thread, NULL, work_run, &app->worker_threads[i]);
+  }
+  pthread_t* threads = (pthread_t*)calloc(app->threads, sizeof(pthread_t));
+  for (int i = 1; i < app->threads; i++) {
+    pthread_create(&threads[i], NULL, run, app);
+  }
+  run(app);
+  for (int i = 1; i < app->threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  /* a NULL item stops each worker once the queued work is done */
+  for (int i = 0; i < app->workers; i++) {
+    workq_push(app->worker_threads[i].queue, NULL);
+  }
+  for (int i = 0; i < app->workers; i++) {
+    pthread_join(app->worker_threads[i].thread, NULL);
+  }
 }
 
 void usage() {
@@ -219,11 +821,29 @@ void usage() {
     printf("[Options]:\n");
     printf("\t-a      The host address [localhost]\n");
     printf("\t-p      The host port [5672]\n");
-    printf("\t-c      # of messages to receive [10]\n");
+    printf("\t-c      # of messages to receive per connection [10]\n");
     printf("\t-t      Target address [examples]\n");
     printf("\t-i      Container name [receive:<pid>]\n");
     printf("\t-u      Client authentication username []\n");
     printf("\t-P      Client authentication password []\n");
+    printf("\t-o      Message output: print, quiet (count only), text (batched writes) or dump:<file> (length prefixed binary) [print]\n");
+    printf("\t-v      Inspect messages in place without a full decode [false]\n");
+    printf("\t-w      Maximum link credit [10000]\n");
+    printf("\t-m      Maximum bytes of messages credit is granted for [67108864]\n");
+    printf("\t-L      Latency target in milliseconds for consuming credited messages [100]\n");
+    printf("\t-A      # of accepted deliveries settled together, 1 to settle each [1]\n");
+    printf("\t-W      Milliseconds an accepted delivery may wait for its batch [5]\n");
+    printf("\t-j      Journal messages to segment files <path>.<n> before accepting them, committed per -A batch []\n");
+    printf("\t-J      Journal segment size in bytes [67108864]\n");
+    printf("\t-D      # of recent message keys checked to accept redeliveries without processing them, shared by the -C connections, 0 for none [0]\n");
+    printf("\t-d      Key identifying a message for -D: message-id or an application property name [message-id]\n");
+    printf("\t-I      Seconds between end to end latency reports, 0 to report at exit only [0]\n");
+    printf("\t-X      # of worker threads processing messages off the event loop, 0 to process on it [0]\n");
+    printf("\t-K      Keep order per key over the -X workers: subject or an application property name []\n");
+    printf("\t-T      # of threads running the proactor [1]\n");
+    printf("\t-C      # of connections [1]\n");
+    printf("\t-k      # of receiver links per connection, each on its own session [1]\n");
+    printf("\t-g      Share the -c message count and the -w credit window over all links [false]\n");
     printf("\t-h      Displays this message\n");
     exit(0);
 
@@ -245,10 +865,28 @@ void parse_args(int argc, char **argv, app_data_t *app) {
     /* default to anonymous authentication */
     app->username = NULL;
     app->password = NULL;
+    app->threads = 1;
+    app->connections = 1;
+    app->stats_interval = 0;
+    app->lazy_view = false;
+    app->output = "print";
+    app->ack_batch = 1;
+    app->credit_window = 10000;
+    app->credit_bytes = 64 * 1024 * 1024;
+    app->credit_latency = 100;
+    app->workers = 0;
+    app->lane_key = NULL;
+    app->ack_window = 5;
+    app->links = 1;
+    app->shared = false;
+    app->journal_path = NULL;
+    app->journal_segment = 64 * 1024 * 1024;
+    app->dedup_window = 0;
+    app->dedup_key = DEDUP_MESSAGE_ID;
 
     /* command line options */
     opterr = 0;
-    while((c = getopt(argc, argv, "i:a:c:t:p:u:P:h")) != -1) {
+    while((c = getopt(argc, argv, "i:a:c:t:p:u:P:T:C:I:vo:A:W:w:m:L:X:K:k:gj:J:D:d:h")) != -1) {
         switch(c) {
         case 'h': usage(); break;
         case 'c':
@@ -268,33 +906,255 @@ void parse_args(int argc, char **argv, app_data_t *app) {
         case 'p': app->port = optarg; break;
         case 'u': app->username = optarg; break;
         case 'P': app->password = optarg; break;
+        case 'v': app->lazy_view = true; break;
+        case 'o': app->output = optarg; break;
+        case 'A':
+            app->ack_batch = atoi(optarg);
+            if (app->ack_batch <= 0) usage();
+            break;
+        case 'w':
+            app->credit_window = atoi(optarg);
+            if (app->credit_window <= 0) usage();
+            break;
+        case 'm':
+            app->credit_bytes = strtoul(optarg, NULL, 10);
+            if (app->credit_bytes == 0) usage();
+            break;
+        case 'L':
+            app->credit_latency = atoi(optarg);
+            if (app->credit_latency <= 0) usage();
+            break;
+        case 'W':
+            app->ack_window = atoi(optarg);
+            if (app->ack_window <= 0) usage();
+            break;
+        case 'I':
+            app->stats_interval = atoi(optarg);
+            if (app->stats_interval < 0) usage();
+            break;
+        case 'X':
+            app->workers = atoi(optarg);
+            if (app->workers < 0) usage();
+            break;
+        case 'K': app->lane_key = optarg; break;
+        case 'T':
+            app->threads = atoi(optarg);
+            if (app->threads <= 0) usage();
+            break;
+        case 'C':
+            app->connections = atoi(optarg);
+            if (app->connections <= 0) usage();
+            break;
+        case 'k':
+            app->links = atoi(optarg);
+            if (app->links <= 0) usage();
+            break;
+        case 'g': app->shared = true; break;
+        case 'j': app->journal_path = optarg; break;
+        case 'J':
+            if (parse_size(optarg, &app->journal_segment) != 0 || app->journal_segment <= JOURNAL_RECORD_HEADER) usage();
+            break;
+        case 'D':
+            if (parse_size(optarg, &app->dedup_window) != 0) usage();
+            break;
+        case 'd': app->dedup_key = optarg; break;
         default: usage(); break;
         }
     }
+    if (app->lane_key && app->workers == 0) {
+        fprintf(stderr, "Option -K needs worker lanes, set -X\n");
+        usage();
+    }
+
+}
 
+/* Initialize connection state, container ids are suffixed with the index when there are several connections */
+static void init_conn_data(app_data_t *app, conn_data_t *conn, int index) {
+    conn->app = app;
+    if (app->connections > 1) {
+        snprintf(conn->container_id, PN_MAX_ADDR, "%s-%d", app->container_id, index);
+    } else {
+        snprintf(conn->container_id, PN_MAX_ADDR, "%s", app->container_id);
+    }
+    if (ack_batch_init(&conn->acks, app->ack_batch, app->ack_window) != 0) {
+        fprintf(stderr, "Unable to allocate ack batch of %d deliveries\n", app->ack_batch);
+        exit(1);
+    }
+    if (app->journal_path) {
+        /* a journal per connection, appended and committed from its own event batches */
+        char path[PN_MAX_ADDR];
+        if (app->connections > 1) {
+            snprintf(path, sizeof(path), "%s-%d", app->journal_path, index);
+        } else {
+            snprintf(path, sizeof(path), "%s", app->journal_path);
+        }
+        if (journal_open(&conn->journal, path, app->journal_segment) != 0) {
+            fprintf(stderr, "Unable to open journal: %s\n", path);
+            exit(1);
+        }
+        /* group commit: one msync per ack batch, then the whole batch is accepted */
+        ack_batch_set_commit(&conn->acks, journal_commit_callback, &conn->journal);
+        /* only messages made durable count toward -c */
+        ack_batch_set_released(&conn->acks, uncount_released, conn);
+    }
+    if (app->dedup_window > 0) {
+        /* a key enters the shared window once its message is accepted, after any journal commit */
+        ack_batch_set_accepted(&conn->acks, record_key, app);
+    }
+    if (app->workers > 0) {
+        /* credit bounds the messages with the workers to the credit window of each link */
+        conn->work_capacity = (size_t)app->links * app->credit_window;
+        conn->work = (work_item_t*)calloc(conn->work_capacity, sizeof(work_item_t));
+        if (!conn->work) {
+            fprintf(stderr, "Unable to allocate work ring of %zu messages\n", conn->work_capacity);
+            exit(1);
+        }
+    }
+    conn->links = (link_data_t*)calloc(app->links, sizeof(link_data_t));
+    if (!conn->links) {
+        fprintf(stderr, "Unable to allocate %d links\n", app->links);
+        exit(1);
+    }
+    /* the byte budget is split over the links sharing it */
+    const size_t bytes = app->credit_bytes / (app->shared ? (size_t)app->connections * app->links : (size_t)app->links);
+    for (int i = 0; i < app->links; i++) {
+        link_data_t *link = &conn->links[i];
+        link->conn = conn;
+        if (app->links > 1) {
+            snprintf(link->name, sizeof(link->name), "my_receiver-%d", i);
+        } else {
+            snprintf(link->name, sizeof(link->name), "my_receiver");
+        }
+        snprintf(link->label, sizeof(link->label), "%s/%s", conn->container_id, link->name);
+        credit_init(&link->credit, app->credit_window, bytes > 0 ? bytes : 1, app->credit_latency);
+        link->report_ns = monotonic_time_ns();
+    }
+    conn->next_report_ns = monotonic_time_ns() + (uint64_t)app->stats_interval * 1000000000;
+    if (recv_pool_init(&conn->pool, RECV_POOL_IDLE) != 0) {
+        fprintf(stderr, "Unable to allocate receive buffer pool\n");
+        exit(1);
+    }
 }
 
 int main(int argc, char **argv) {
     struct app_data_t app = {0};
     char addr[PN_MAX_ADDR];
+    int exit_code = 0;
 
     parse_args(argc, argv, &app);
+    if (sink_open(&app.sink, app.output) != 0) {
+        fprintf(stderr, "Invalid message output: %s\n", app.output);
+        usage();
+    }
+    if (app.workers > 0) {
+        app.worker_threads = (worker_t*)calloc(app.workers, sizeof(worker_t));
+        /* each queue can hold every connection's messages in flight plus a stop item per worker */
+        const size_t capacity = (size_t)app.connections * app.links * app.credit_window + app.workers;
+        if (workq_init(&app.queue, capacity) != 0) {
+            fprintf(stderr, "Unable to allocate work queue\n");
+            exit(1);
+        }
+        for (int i = 0; app.lane_key && i < app.workers; i++) {
+            if (workq_init(&app.worker_threads[i].lane, capacity) != 0) {
+                fprintf(stderr, "Unable to allocate work lane\n");
+                exit(1);
+            }
+        }
+        app.next_lane_report_ns = monotonic_time_ns() + (uint64_t)app.stats_interval * 1000000000;
+    }
+    conn_data_t *conns = (conn_data_t*)calloc(app.connections, sizeof(conn_data_t));
+    app.conns = conns;
+    pthread_mutex_init(&app.conns_lock, NULL);
+    if (app.dedup_window > 0 && dedup_init(&app.dedup, app.dedup_window, app.dedup_key) != 0) {
+        fprintf(stderr, "Unable to allocate dedup window of %zu keys\n", app.dedup_window);
+        exit(1);
+    }
+    pthread_mutex_init(&app.dedup_lock, NULL);
 
     /* Create the proactor and connect */
     app.proactor = pn_proactor();
     pn_proactor_addr(addr, sizeof(addr), app.host, app.port);
     fprintf(stdout, "Connecting to host: %s\n", addr);
 
-    /* Initialize Sasl transport */
-    pn_transport_t *pnt = pn_transport();
-    pn_sasl_set_allow_insecure_mechs(pn_sasl(pnt), true);
+    for (int i = 0; i < app.connections; i++) {
+        init_conn_data(&app, &conns[i], i);
+        pn_connection_t *c = pn_connection();
+        pn_connection_set_context(c, &conns[i]);
+        conns[i].connection = c;
+        /* Initialize Sasl transport */
+        pn_transport_t *pnt = pn_transport();
+        pn_sasl_set_allow_insecure_mechs(pn_sasl(pnt), true);
+        pn_proactor_connect2(app.proactor, c, pnt, addr);
+    }
 
-    /* initialize and start proton event proactor loop */
-    pn_proactor_connect2(app.proactor, NULL, pnt, addr);
+    /* start proton event proactor loop */
     fprintf(stdout, "waiting to receive %d messages from amqp address: %s\n", app.message_count, app.amqp_address);
-    run(&app);
+    if (timer_interval_ms(&app) != INT_MAX) {
+        pn_proactor_set_timeout(app.proactor, timer_interval_ms(&app));
+    }
+    run_threads(&app);
+    sink_close(&app.sink);
+    if (sink_failed(&app.sink)) {
+        exit_code = 1;
+    }
 
     /* program cleanup */
+    stamp_stats_t *stamps = (stamp_stats_t*)calloc(1, sizeof(stamp_stats_t));
+    recv_pool_t buffers = {0};
+    ack_batch_t acks = {0};
+    journal_t journal = {0};
+    for (int i = 0; i < app.connections; i++) {
+        stamp_merge(stamps, &conns[i].stamps);
+        recv_pool_merge(&buffers, &conns[i].pool);
+        ack_batch_merge(&acks, &conns[i].acks);
+        if (conns[i].acks.released > 0) exit_code = 1;
+        ack_batch_free(&conns[i].acks);
+        if (app.journal_path) {
+            journal_close(&conns[i].journal);
+            journal_merge(&journal, &conns[i].journal);
+        }
+        for (int l = 0; l < app.links; l++) {
+            credit_print(&conns[i].links[l].credit, conns[i].links[l].label, stdout);
+            print_link(&conns[i].links[l], 0, true, stdout);
+        }
+        free(conns[i].links);
+        if (conns[i].exit_code) exit_code = conns[i].exit_code;
+        recv_pool_put(&conns[i].pool, &conns[i].msgin);
+        /* buffers of messages processed after their connection closed */
+        for (size_t w = conns[i].work_head; w != conns[i].work_tail; w++) {
+            recv_pool_put(&conns[i].pool, &conns[i].work[w % conns[i].work_capacity].buffer);
+        }
+        free(conns[i].work);
+        recv_pool_free(&conns[i].pool);
+    }
+    for (int i = 0; i < app.workers; i++) {
+        stamp_merge(stamps, &app.worker_threads[i].stamps);
+    }
+    if (app.lane_key) {
+        print_lanes(&app, stdout);
+        for (int i = 0; i < app.workers; i++) {
+            workq_free(&app.worker_threads[i].lane);
+        }
+    }
+    if (app.workers > 0) {
+        free(app.worker_threads);
+        workq_free(&app.queue);
+    }
+    stamp_print(stamps, "e2e latency", stdout);
+    recv_pool_print(&buffers, stdout);
+    ack_batch_print(&acks, stdout);
+    if (app.journal_path) {
+        journal_print(&journal, stdout);
+    }
+    if (app.dedup_window > 0) {
+        dedup_print(&app.dedup, stdout);
+        dedup_free(&app.dedup);
+    }
+    sink_print(&app.sink, stdout);
+    free(stamps);
+    free(conns);
+    pthread_mutex_destroy(&app.conns_lock);
+    pthread_mutex_destroy(&app.dedup_lock);
     pn_proactor_free(app.proactor);
     str_free(app.container_id);
     return exit_code;
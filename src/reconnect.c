@@ -0,0 +1,93 @@
+
+#include "reconnect.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "util.h"
+
+void reconnect_init(reconnect_t *reconnect, const int max_attempts) {
+    reconnect->max_attempts = max_attempts;
+    reconnect->attempts = 0;
+    reconnect->due_ns = 0;
+    reconnect->down_ns = 0;
+    /* seeded per process so clients started together still spread out */
+    reconnect->rng = realtime_ns() ^ ((uint64_t)getpid() << 32) ^ 0x9e3779b97f4a7c15ULL;
+    reconnect->reconnects = 0;
+    reconnect->resent = 0;
+    reconnect->acks_discarded = 0;
+    reconnect->disconnected_ns = 0;
+}
+
+/* xorshift64 */
+static uint64_t next_random(reconnect_t *reconnect) {
+    uint64_t x = reconnect->rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    reconnect->rng = x;
+    return x;
+}
+
+bool reconnect_schedule(reconnect_t *reconnect, const uint64_t now_ns) {
+    if (reconnect->attempts >= reconnect->max_attempts) {
+        return false;
+    }
+    if (reconnect->down_ns == 0) {
+        reconnect->down_ns = now_ns;
+    }
+    uint64_t wait_ms = RECONNECT_INITIAL_MS;
+    for (int i = 0; i < reconnect->attempts && wait_ms < RECONNECT_MAX_MS; i++) {
+        wait_ms *= 2;
+    }
+    if (wait_ms > RECONNECT_MAX_MS) {
+        wait_ms = RECONNECT_MAX_MS;
+    }
+    /* wait between half and all of the backoff */
+    wait_ms = wait_ms / 2 + next_random(reconnect) % (wait_ms / 2 + 1);
+    reconnect->attempts++;
+    reconnect->due_ns = now_ns + wait_ms * 1000000;
+    return true;
+}
+
+bool reconnect_pending(const reconnect_t *reconnect) {
+    return reconnect->due_ns != 0;
+}
+
+bool reconnect_due(reconnect_t *reconnect, const uint64_t now_ns) {
+    if (reconnect->due_ns == 0 || now_ns < reconnect->due_ns) {
+        return false;
+    }
+    reconnect->due_ns = 0;
+    return true;
+}
+
+int reconnect_wait_ms(const reconnect_t *reconnect, const uint64_t now_ns) {
+    if (reconnect->due_ns <= now_ns) {
+        return 0;
+    }
+    /* round up so the timer does not fire just before the attempt is due */
+    return (int)((reconnect->due_ns - now_ns + 999999) / 1000000);
+}
+
+void reconnect_opened(reconnect_t *reconnect, const uint64_t now_ns) {
+    if (reconnect->down_ns != 0) {
+        reconnect->disconnected_ns += now_ns - reconnect->down_ns;
+        reconnect->down_ns = 0;
+        reconnect->reconnects++;
+    }
+    reconnect->attempts = 0;
+}
+
+void reconnect_print(const reconnect_t *reconnect, FILE *out) {
+    fprintf(out, "reconnect: %llu reconnects, %llu deliveries resent, %.3f s disconnected\n",
+            (unsigned long long)reconnect->reconnects, (unsigned long long)reconnect->resent,
+            reconnect->disconnected_ns / 1e9);
+    if (reconnect->acks_discarded > 0) {
+        /* the broker decides whether these come back, they are not counted as resent */
+        fprintf(out, "reconnect: %llu acks discarded, their deliveries were not settled before the drop\n",
+                (unsigned long long)reconnect->acks_discarded);
+    }
+}
@@ -0,0 +1,93 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+
+#ifndef RECONNECT_H
+#define RECONNECT_H 1
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+/*
+ * Reconnect schedule after a dropped connection.
+ *
+ * Each consecutive attempt waits twice as long as the one before, from
+ * RECONNECT_INITIAL_MS up to RECONNECT_MAX_MS, and a random jitter of up
+ * to half the wait keeps many clients that lost the same broker from
+ * reconnecting in lock step. The attempts start over once a connection
+ * has been opened again.
+ * */
+typedef struct reconnect_t {
+  int max_attempts;          /* consecutive attempts before giving up, 0 to never reconnect */
+  int attempts;              /* consecutive attempts since the last open */
+  uint64_t due_ns;           /* when the scheduled attempt is due, 0 if none */
+  uint64_t down_ns;          /* when the connection was lost, 0 while connected */
+  uint64_t rng;              /* jitter state */
+  uint64_t reconnects;       /* connections opened again */
+  uint64_t resent;           /* unsettled deliveries sent again after a drop */
+  uint64_t acks_discarded;   /* received deliveries whose acknowledgement was lost with the connection */
+  uint64_t disconnected_ns;  /* total time without a connection */
+} reconnect_t;
+
+#define RECONNECT_INITIAL_MS 100
+
+#define RECONNECT_MAX_MS 10000
+
+void reconnect_init(reconnect_t *reconnect, const int max_attempts);
+
+/*
+ * Schedules the next attempt after the connection was lost or an attempt
+ * failed.
+ *
+ * @returns: false if reconnecting is disabled or the attempts are used up
+ * */
+bool reconnect_schedule(reconnect_t *reconnect, const uint64_t now_ns);
+
+/*
+ * Returns true if an attempt is scheduled.
+ * */
+bool reconnect_pending(const reconnect_t *reconnect);
+
+/*
+ * Returns true once when the scheduled attempt is due, the caller connects.
+ * */
+bool reconnect_due(reconnect_t *reconnect, const uint64_t now_ns);
+
+/*
+ * Returns the milliseconds until the scheduled attempt is due.
+ * */
+int reconnect_wait_ms(const reconnect_t *reconnect, const uint64_t now_ns);
+
+/*
+ * Records that the connection is open, ending the time disconnected.
+ * */
+void reconnect_opened(reconnect_t *reconnect, const uint64_t now_ns);
+
+/*
+ * Prints the reconnects, deliveries resent, acknowledgements discarded and
+ * time disconnected.
+ * */
+void reconnect_print(const reconnect_t *reconnect, FILE *out);
+
+#endif /* reconnect.h */
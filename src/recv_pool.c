@@ -0,0 +1,87 @@
+
+#include "recv_pool.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int recv_pool_init(recv_pool_t *pool, const size_t max_idle) {
+    pool->idle = (recv_buffer_t*)calloc(max_idle ? max_idle : 1, sizeof(recv_buffer_t));
+    if (!pool->idle) {
+        return -1;
+    }
+    pool->idle_count = 0;
+    pool->max_idle = max_idle;
+    pool->size_hint = RECV_POOL_MIN_SIZE;
+    pool->allocations = 0;
+    pool->avoided = 0;
+    return 0;
+}
+
+void recv_pool_free(recv_pool_t *pool) {
+    for (size_t i = 0; i < pool->idle_count; i++) {
+        free(pool->idle[i].start);
+    }
+    free(pool->idle);
+    pool->idle = NULL;
+    pool->idle_count = 0;
+}
+
+/* smallest power of two capacity from 'from' holding needed bytes */
+static size_t grown_capacity(size_t from, const size_t needed) {
+    if (from < RECV_POOL_MIN_SIZE) {
+        from = RECV_POOL_MIN_SIZE;
+    }
+    while (from < needed) {
+        from *= 2;
+    }
+    return from;
+}
+
+int recv_pool_reserve(recv_pool_t *pool, recv_buffer_t *buf, const size_t needed) {
+    if (!buf->start && pool->idle_count > 0) {
+        *buf = pool->idle[--pool->idle_count];
+        buf->size = 0;
+    }
+    if (buf->start && buf->capacity >= needed) {
+        pool->avoided++;
+        return 0;
+    }
+    size_t capacity = grown_capacity(buf->start ? buf->capacity : pool->size_hint, needed);
+    char *start = (char*)realloc(buf->start, capacity);
+    if (!start) {
+        return -1;
+    }
+    pool->allocations++;
+    buf->start = start;
+    buf->capacity = capacity;
+    return 0;
+}
+
+void recv_pool_put(recv_pool_t *pool, recv_buffer_t *buf) {
+    if (!buf->start) {
+        return;
+    }
+    /* size new buffers for the largest message kept so far */
+    if (buf->size > pool->size_hint && buf->size <= RECV_POOL_MAX_KEEP) {
+        pool->size_hint = grown_capacity(pool->size_hint, buf->size);
+    }
+    if (pool->idle_count < pool->max_idle && buf->capacity <= RECV_POOL_MAX_KEEP) {
+        pool->idle[pool->idle_count++] = *buf;
+    } else {
+        free(buf->start);
+    }
+    buf->start = NULL;
+    buf->size = 0;
+    buf->capacity = 0;
+}
+
+void recv_pool_merge(recv_pool_t *dest, const recv_pool_t *src) {
+    dest->allocations += src->allocations;
+    dest->avoided += src->avoided;
+}
+
+void recv_pool_print(const recv_pool_t *pool, FILE *out) {
+    fprintf(out, "receive buffers: %llu allocations, %llu avoided\n",
+            (unsigned long long)pool->allocations, (unsigned long long)pool->avoided);
+}
@@ -0,0 +1,98 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifndef RECV_POOL_H
+#define RECV_POOL_H 1
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/*
+ * A buffer accumulating the bytes of an incoming message.
+ * */
+typedef struct recv_buffer_t {
+  char *start;       /* NULL when no buffer is held */
+  size_t size;       /* bytes received so far */
+  size_t capacity;   /* bytes allocated */
+} recv_buffer_t;
+
+/*
+ * Pool of receive buffers reused across deliveries.
+ *
+ * New buffers are sized from the largest message seen so far, so most
+ * messages are received into a buffer without any allocation. A buffer
+ * only grows, geometrically, when a message outgrows it. Buffers larger
+ * than RECV_POOL_MAX_KEEP are freed rather than kept in the pool.
+ * A pool is not thread safe, use one per connection or event loop.
+ * */
+typedef struct recv_pool_t {
+  recv_buffer_t *idle;     /* stack of buffers ready for reuse */
+  size_t idle_count;
+  size_t max_idle;
+  size_t size_hint;        /* capacity of new buffers */
+  uint64_t allocations;    /* malloc and realloc calls made */
+  uint64_t avoided;        /* allocations avoided by reusing or fitting in a buffer */
+} recv_pool_t;
+
+#define RECV_POOL_MIN_SIZE 256
+
+#define RECV_POOL_MAX_KEEP (1024 * 1024)
+
+/*
+ * Initializes an empty pool keeping up to max_idle buffers for reuse.
+ *
+ * @returns: 0 on success, -1 if allocation failed
+ * */
+int recv_pool_init(recv_pool_t *pool, const size_t max_idle);
+
+/*
+ * Frees the idle buffers. Buffers still held by the caller must be
+ * returned first or freed by the caller.
+ * */
+void recv_pool_free(recv_pool_t *pool);
+
+/*
+ * Makes room for at least 'needed' bytes in buf, taking a buffer from
+ * the pool if buf holds none. The received size is kept.
+ *
+ * @returns: 0 on success, -1 if allocation failed
+ * */
+int recv_pool_reserve(recv_pool_t *pool, recv_buffer_t *buf, const size_t needed);
+
+/*
+ * Returns the buffer to the pool and resets buf to empty.
+ * */
+void recv_pool_put(recv_pool_t *pool, recv_buffer_t *buf);
+
+/*
+ * Adds the counters of src to dest.
+ * */
+void recv_pool_merge(recv_pool_t *dest, const recv_pool_t *src);
+
+/*
+ * Prints the allocation counters.
+ * */
+void recv_pool_print(const recv_pool_t *pool, FILE *out);
+
+#endif /* recv_pool.h */
@@ -34,12 +34,23 @@
 #include <proton/transport.h>
 #include <proton/sasl.h>
 
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 
 #include "util.h"
+#include "msg_template.h"
+#include "inflight.h"
+#include "histogram.h"
+#include "pacer.h"
+#include "payload.h"
+#include "stamp.h"
+#include "mapped_file.h"
 
 typedef struct app_data_t {
   const char *host, *port;
@@ -47,14 +58,51 @@ typedef struct app_data_t {
   const char *amqp_address;
   const char *container_id;
   int message_count;
+  bool use_template;
+  int max_inflight;
+  bool presettled;
+  int threads;
+  int connections;
+  bool stamp;                  /* add send time and sequence properties */
+  bool payload_mode;           /* send generated payload bodies of -s sizes */
+  bool binary_body;
+  payload_t payload;           /* shared read-only once generated */
+  int rate;                    /* messages per second per connection, 0 for unpaced */
+  int burst;
+  const char *stream_path;     /* file streamed as each message body, NULL if not streaming */
+  mapped_file_t stream_file;   /* shared read-only mapping of stream_path */
 
   pn_proactor_t *proactor;
+  struct conn_data_t *conns;
+  pthread_mutex_t conns_lock;  /* guards conn_data_t.connection for the send tick */
+} app_data_t;
+
+/*
+ * Per connection state. The proactor serializes events for a connection,
+ * so only the thread handling the current event batch touches it.
+ */
+typedef struct conn_data_t {
+  app_data_t *app;
+  char container_id[PN_MAX_ADDR];
+  pn_connection_t *connection; /* NULL once the transport is closed */
+  pn_link_t *sender;
   pn_rwbytes_t message_buffer;
+  msg_template_t message_template; /* pre-encoded message for template mode */
   int sent;
   int acknowledged;
-} app_data_t;
-
-static int exit_code = 0;
+  inflight_t inflight;         /* unsettled deliveries by delivery tag */
+  histogram_t ack_latency;     /* publish to acknowledgement time */
+  pacer_t pacer;
+  atomic_uint_fast64_t tick_ns; /* when the pacer next needs a send tick, read by the timer */
+  uint64_t rng;                /* payload size picker state */
+  size_t stamp_time_offset;    /* template offsets of the stamp property values */
+  size_t stamp_sequence_offset;
+  histogram_t send_lag;        /* actual minus scheduled send time when paced */
+  pn_delivery_t *stream_delivery; /* delivery whose body is still being streamed */
+  size_t stream_offset;        /* body bytes of stream_delivery sent so far */
+  bool send_done;              /* all pre-settled messages sent */
+  int exit_code;
+} conn_data_t;
 
 extern int optind;
 extern char* optarg;
@@ -63,7 +111,7 @@ extern int opterr;
 
 #define str_free(strptr) free((void *)strptr)
 
-static void check_condition(pn_event_t *e, pn_condition_t *cond) {
+static void check_condition(conn_data_t *conn, pn_event_t *e, pn_condition_t *cond) {
   if (pn_condition_is_set(cond)) {
     fprintf(stderr, "%s: %s: %s\n", pn_event_type_name(pn_event_type(e)),
             pn_condition_get_name(cond), pn_condition_get_description(cond));
@@ -86,43 +134,47 @@ static void check_condition(pn_event_t *e, pn_condition_t *cond) {
 
     }
     pn_connection_close(pn_event_connection(e));
-    exit_code = 1;
+    if (conn) conn->exit_code = 1;
   }
 }
 
 /* Create a message with a string "sequence_<number>" encode it and return the encoded buffer. */
-static pn_bytes_t encode_message(app_data_t* app) {
+static pn_bytes_t encode_message(conn_data_t* conn) {
   /* Construct a message with the string "sequence_<app.sent>" */
   pn_message_t* message = pn_message();
   pn_data_t* body = pn_message_body(message);
   /* Create string for amqp message body */
   size_t slen = sizeof("sequence_") + 12;
   char* sbuf = malloc(slen);
-  int swritten = sprintf(sbuf, "sequence_%d", app->sent);
+  int swritten = sprintf(sbuf, "sequence_%d", conn->sent);
   if (swritten < 0) {
-    fprintf(stderr, "error writing message body string for sequence %d", app->sent);
+    fprintf(stderr, "error writing message body string for sequence %d", conn->sent);
     exit(1);
   }
   pn_data_put_string(body, pn_bytes(swritten, sbuf));
+  free(sbuf); /* the body data holds its own copy */
 
   /* set message durable flag */
   pn_message_set_durable(message, true);
+  if (conn->app->stamp) {
+    stamp_message(message, realtime_ns(), conn->sent);
+  }
 
   /* encode the message, expanding the encode buffer as needed */
-  if (app->message_buffer.start == NULL) {
+  if (conn->message_buffer.start == NULL) {
     static const size_t initial_size = 128;
-    app->message_buffer = pn_rwbytes(initial_size, (char*)malloc(initial_size));
+    conn->message_buffer = pn_rwbytes(initial_size, (char*)malloc(initial_size));
   }
-  /* app->message_buffer is the total buffer space available. */
+  /* conn->message_buffer is the total buffer space available. */
   /* mbuf wil point at just the portion used by the encoded message */
   {
-  pn_rwbytes_t mbuf = pn_rwbytes(app->message_buffer.size, app->message_buffer.start);
+  pn_rwbytes_t mbuf = pn_rwbytes(conn->message_buffer.size, conn->message_buffer.start);
   int status = 0;
   while ((status = pn_message_encode(message, mbuf.start, &mbuf.size)) == PN_OVERFLOW) {
-    app->message_buffer.size *= 2;
-    app->message_buffer.start = (char*)realloc(app->message_buffer.start, app->message_buffer.size);
-    mbuf.size = app->message_buffer.size;
-    mbuf.start = app->message_buffer.start;
+    conn->message_buffer.size *= 2;
+    conn->message_buffer.start = (char*)realloc(conn->message_buffer.start, conn->message_buffer.size);
+    mbuf.size = conn->message_buffer.size;
+    mbuf.start = conn->message_buffer.start;
   }
   if (status != 0) {
     fprintf(stderr, "error encoding message: %s\n", pn_error_text(pn_message_error(message)));
@@ -133,8 +185,208 @@ static pn_bytes_t encode_message(app_data_t* app) {
   }
 }
 
+/*
+ * Encode the message sections that are the same for every message once.
+ * encode_message_from_template then only patches the "sequence_<number>"
+ * body, avoiding a pn_message_t, a body string and a full encode per message.
+ * With -s the template ends at the body section header and send_message
+ * follows it with the generated payload bytes, with -f the file is streamed
+ * after it as a data section.
+ */
+static void init_message_template(conn_data_t* conn) {
+  pn_message_t* message = pn_message();
+  /* set message durable flag */
+  pn_message_set_durable(message, true);
+  if (conn->app->stamp) {
+    /* placeholders located after encoding and patched per message */
+    stamp_message(message, STAMP_TIME_PLACEHOLDER, STAMP_SEQUENCE_PLACEHOLDER);
+  }
+  int status = conn->app->stream_path
+    ? msg_template_init_payload(&conn->message_template, message, true)
+    : conn->app->payload_mode
+    ? msg_template_init_payload(&conn->message_template, message, conn->app->binary_body)
+    : msg_template_init(&conn->message_template, message, "sequence_");
+  if (status != 0) {
+    fprintf(stderr, "error encoding message template: %s\n", pn_code(status));
+    exit(1);
+  }
+  if (conn->app->stamp
+      && (msg_template_find_ulong(&conn->message_template, STAMP_TIME_PLACEHOLDER, &conn->stamp_time_offset) != 0
+          || msg_template_find_ulong(&conn->message_template, STAMP_SEQUENCE_PLACEHOLDER, &conn->stamp_sequence_offset) != 0)) {
+    fprintf(stderr, "error locating stamp properties in message template\n");
+    exit(1);
+  }
+  pn_message_free(message);
+}
+
+static pn_bytes_t encode_message_from_template(conn_data_t* conn) {
+  return msg_template_encode(&conn->message_template, conn->sent);
+}
+
+/* Encode and send the message for the current delivery */
+static void send_message(conn_data_t* conn, pn_link_t* sender) {
+  app_data_t* app = conn->app;
+  if (app->stamp && (app->use_template || app->payload_mode || app->stream_path)) {
+    msg_template_patch_ulong(&conn->message_template, conn->stamp_time_offset, realtime_ns());
+    msg_template_patch_ulong(&conn->message_template, conn->stamp_sequence_offset, conn->sent);
+  }
+  if (app->stream_path) {
+    /* only the sections up to the body, stream_message sends the file bytes */
+    pn_bytes_t head = msg_template_encode_payload(&conn->message_template, app->stream_file.bytes.size);
+    pn_link_send(sender, head.start, head.size);
+  } else if (app->payload_mode) {
+    /* send the pre-encoded sections then a prefix of the shared payload bytes */
+    size_t size = payload_next_size(&app->payload, &conn->rng);
+    pn_bytes_t head = msg_template_encode_payload(&conn->message_template, size);
+    pn_link_send(sender, head.start, head.size);
+    pn_link_send(sender, app->payload.buffer.start, size);
+  } else {
+    pn_bytes_t msgbuf = app->use_template ? encode_message_from_template(conn) : encode_message(conn);
+    pn_link_send(sender, msgbuf.start, msgbuf.size);
+  }
+}
+
+/* Complete the current delivery, settling it up front when pre-settled */
+static void finish_delivery(conn_data_t* conn, pn_link_t* sender, pn_delivery_t* d) {
+  pn_link_advance(sender);
+  if (conn->app->presettled) {
+    /* fire and forget, the peer sends no disposition for settled deliveries */
+    pn_delivery_settle(d);
+  }
+}
+
+/* Size of each partial send of a streamed body */
+#define STREAM_CHUNK (64 * 1024)
+
+/* Streamed body bytes allowed to wait in the session for transfer frames */
+#define STREAM_WINDOW (1024 * 1024)
+
+/*
+ * Send the next chunks of the streamed body while the session has room,
+ * so a large file is never copied into proton buffers in one go and the
+ * consumed pages of the mapping are dropped as it goes. Returns true once
+ * the delivery is complete, false if the rest waits for the next send tick.
+ */
+static bool stream_message(conn_data_t* conn, pn_link_t* sender) {
+  mapped_file_t* file = &conn->app->stream_file;
+  pn_session_t* session = pn_link_session(sender);
+  while (conn->stream_offset < file->bytes.size && pn_session_outgoing_bytes(session) < STREAM_WINDOW) {
+    size_t chunk = file->bytes.size - conn->stream_offset;
+    if (chunk > STREAM_CHUNK) chunk = STREAM_CHUNK;
+    /* pn_link_send copies the bytes, the pages are no longer needed */
+    pn_link_send(sender, file->bytes.start + conn->stream_offset, chunk);
+    mapped_file_release(file, conn->stream_offset, chunk);
+    conn->stream_offset += chunk;
+  }
+  if (conn->stream_offset < file->bytes.size) {
+    return false;
+  }
+  finish_delivery(conn, sender, conn->stream_delivery);
+  conn->stream_delivery = NULL;
+  return true;
+}
+
+/* Returns the integer delivery tag set from the sent counter, 0 if not recognized */
+static int delivery_tag_id(pn_delivery_t* d) {
+  pn_delivery_tag_t tag = pn_delivery_tag(d);
+  int id = 0;
+  if (tag.size == sizeof(id)) {
+    memcpy(&id, tag.start, sizeof(id));
+  }
+  return id;
+}
+
+/*
+ * Send messages while the peer has given credit and the in-flight window
+ * has a free slot for the next delivery tag. When paced only the messages
+ * due by now are sent, the rest wait for the next send tick. A streamed
+ * body is finished before the next message is started.
+ */
+static void send_messages(conn_data_t* conn, pn_link_t* sender) {
+  app_data_t* app = conn->app;
+  if (conn->stream_delivery && !stream_message(conn, sender)) {
+    return;
+  }
+  int tokens = app->rate > 0 ? pacer_available(&conn->pacer, monotonic_time_ns()) : 1;
+  while (tokens > 0 && pn_link_credit(sender) > 0 && conn->sent < app->message_count
+         && (app->presettled || inflight_available(&conn->inflight, conn->sent + 1))) {
+    ++conn->sent;
+    /* Use sent counter as unique delivery tag. */
+    pn_delivery_t* d = pn_delivery(sender, pn_dtag((const char *)&conn->sent, sizeof(conn->sent)));
+    {
+    uint64_t now = monotonic_time_ns();
+    uint64_t scheduled = now;
+    if (app->rate > 0) {
+      /* latency is measured from the scheduled time so sender stalls are not hidden */
+      scheduled = pacer_take(&conn->pacer);
+      histogram_record(&conn->send_lag, now > scheduled ? now - scheduled : 0);
+      --tokens;
+    }
+    if (!app->presettled) {
+      inflight_add(&conn->inflight, conn->sent, scheduled);
+    }
+    send_message(conn, sender);
+    }
+    if (app->stream_path) {
+      conn->stream_delivery = d;
+      conn->stream_offset = 0;
+      if (!stream_message(conn, sender)) {
+        break;
+      }
+    } else {
+      finish_delivery(conn, sender, d);
+    }
+  }
+  if (app->rate > 0) {
+    /* the timer sleeps until this connection's next message is due */
+    const uint64_t now = monotonic_time_ns();
+    atomic_store(&conn->tick_ns, now + (uint64_t)pacer_wait_ms(&conn->pacer, now) * 1000000);
+  }
+  if (app->presettled && !conn->send_done && !conn->stream_delivery && conn->sent == app->message_count) {
+    conn->send_done = true;
+    printf("%d messages sent pre-settled\n", conn->sent);
+    pn_connection_close(pn_session_connection(pn_link_session(sender)));
+    /* Continue handling events till we receive TRANSPORT_CLOSED */
+  }
+}
+
+/* Interval of the send tick resuming streamed sends */
+#define SEND_TICK_MS 1
+
+/*
+ * Wake the open connections due a send tick so they send the messages now
+ * due, every one when streaming. Returns the milliseconds until the next
+ * connection is due, -1 once every connection is closed.
+ */
+static int wake_connections(app_data_t* app) {
+  const uint64_t now = monotonic_time_ns();
+  uint64_t next = UINT64_MAX;
+  pthread_mutex_lock(&app->conns_lock);
+  for (int i = 0; i < app->connections; i++) {
+    conn_data_t *conn = &app->conns[i];
+    if (!conn->connection) {
+      continue;
+    }
+    uint64_t due = app->stream_path ? now : atomic_load(&conn->tick_ns);
+    if (due <= now) {
+      pn_connection_wake(conn->connection);
+      /* it sets its own next tick once it has sent */
+      due = now + SEND_TICK_MS * 1000000;
+    }
+    next = due < next ? due : next;
+  }
+  pthread_mutex_unlock(&app->conns_lock);
+  if (next == UINT64_MAX) {
+    return -1;
+  }
+  const uint64_t wait = (next - now + 999999) / 1000000;
+  return wait < 1 ? 1 : wait > INT_MAX ? INT_MAX : (int)wait;
+}
+
 /* Returns true to continue, false if finished */
 static bool handle(app_data_t* app, pn_event_t* event) {
+  pn_connection_t* pnc = pn_event_connection(event);
+  conn_data_t* conn = pnc ? (conn_data_t*)pn_connection_get_context(pnc) : NULL;
   switch (pn_event_type(event)) {
 
    case PN_CONNECTION_INIT: {
@@ -145,11 +397,12 @@ static bool handle(app_data_t* app, pn_event_t* event) {
         pn_connection_set_password(c, app->password);
      }
      pn_session_t* s = pn_session(pn_event_connection(event));
-     pn_connection_set_container(c, app->container_id);
+     pn_connection_set_container(c, conn->container_id);
      pn_connection_open(c);
      pn_session_open(s);
      {
      pn_link_t* l = pn_sender(s, "my_sender");
+     conn->sender = l;
      /* 
       * Set the terminus address to the target destination or node 
       * on the remote broker.
@@ -160,6 +413,10 @@ static bool handle(app_data_t* app, pn_event_t* event) {
       * queue as well.
       * */
      pn_terminus_set_address(pn_link_target(l), app->amqp_address);
+     if (app->presettled) {
+       /* tell the peer all deliveries on this link are sent settled */
+       pn_link_set_snd_settle_mode(l, PN_SND_SETTLED);
+     }
      pn_link_open(l);
      break;
      }
@@ -167,60 +424,85 @@ static bool handle(app_data_t* app, pn_event_t* event) {
 
    case PN_LINK_FLOW: {
      /* The peer has given us some credit, now we can send messages */
-     pn_link_t *sender = pn_event_link(event);
-     while (pn_link_credit(sender) > 0 && app->sent < app->message_count) {
-       ++app->sent;
-       /* Use sent counter as unique delivery tag. */
-       pn_delivery(sender, pn_dtag((const char *)&app->sent, sizeof(app->sent)));
-       {
-       pn_bytes_t msgbuf = encode_message(app);
-       pn_link_send(sender, msgbuf.start, msgbuf.size);
-       }
-       pn_link_advance(sender);
-     }
+     send_messages(conn, pn_event_link(event));
      break;
    }
 
    case PN_DELIVERY: {
      /* We received acknowledgement from the peer that a message was delivered. */
      pn_delivery_t* d = pn_event_delivery(event);
+     /* free the in-flight slot and record the time to acknowledgement */
+     uint64_t sent_ns;
+     if (inflight_remove(&conn->inflight, delivery_tag_id(d), &sent_ns)) {
+       histogram_record(&conn->ack_latency, monotonic_time_ns() - sent_ns);
+     }
      if (pn_delivery_remote_state(d) == PN_ACCEPTED) {
-       if (++app->acknowledged == app->message_count) {
-         printf("%d messages sent and acknowledged\n", app->acknowledged);
+       pn_delivery_settle(d); /* settle and free d */
+       if (++conn->acknowledged == app->message_count) {
+         printf("%d messages sent and acknowledged\n", conn->acknowledged);
          pn_connection_close(pn_event_connection(event));
          /* Continue handling events till we receive TRANSPORT_CLOSED */
+       } else {
+         /* the window may have been full, send with any remaining credit */
+         send_messages(conn, pn_delivery_link(d));
        }
      } else {
        pn_disposition_t* disposition = pn_delivery_remote(d);
        fprintf(stderr, "unexpected delivery state %d\n", (int)pn_delivery_remote_state(d));
-       check_condition(event, pn_disposition_condition(disposition));
+       check_condition(conn, event, pn_disposition_condition(disposition));
        pn_connection_close(pn_event_connection(event));
-       exit_code=1;
+       conn->exit_code=1;
      }
      break;
    }
 
+   case PN_CONNECTION_WAKE:
+    /* send tick, send the messages that are now due and resume streaming */
+    if (conn->sender) {
+      send_messages(conn, conn->sender);
+    }
+    break;
+
+   case PN_PROACTOR_TIMEOUT: {
+    /* keep ticking while a connection is open */
+    int wait_ms = wake_connections(app);
+    if (wait_ms > 0) {
+      pn_proactor_set_timeout(app->proactor, wait_ms);
+    }
+    break;
+   }
+
    case PN_TRANSPORT_CLOSED:
-    check_condition(event, pn_transport_condition(pn_event_transport(event)));
+    check_condition(conn, event, pn_transport_condition(pn_event_transport(event)));
+    if (conn) {
+      /* the connection is freed after this event, stop the send tick waking it */
+      pthread_mutex_lock(&app->conns_lock);
+      conn->connection = NULL;
+      conn->sender = NULL;
+      pthread_mutex_unlock(&app->conns_lock);
+    }
     break;
 
    case PN_CONNECTION_REMOTE_CLOSE:
-    check_condition(event, pn_connection_remote_condition(pn_event_connection(event)));
+    check_condition(conn, event, pn_connection_remote_condition(pn_event_connection(event)));
     pn_connection_close(pn_event_connection(event));
     break;
 
    case PN_SESSION_REMOTE_CLOSE:
-    check_condition(event, pn_session_remote_condition(pn_event_session(event)));
+    check_condition(conn, event, pn_session_remote_condition(pn_event_session(event)));
     pn_connection_close(pn_event_connection(event));
     break;
 
    case PN_LINK_REMOTE_CLOSE:
    case PN_LINK_REMOTE_DETACH:
-    check_condition(event, pn_link_remote_condition(pn_event_link(event)));
+    check_condition(conn, event, pn_link_remote_condition(pn_event_link(event)));
     pn_connection_close(pn_event_connection(event));
     break;
 
    case PN_PROACTOR_INACTIVE:
+   case PN_PROACTOR_INTERRUPT:
+    /* all connections are closed, interrupt the next thread so it stops too */
+    pn_proactor_interrupt(app->proactor);
     return false;
 
    default: break;
@@ -228,29 +510,56 @@ static bool handle(app_data_t* app, pn_event_t* event) {
   return true;
 }
 
-void run(app_data_t *app) {
+void* run(void *arg) {
+  app_data_t *app = (app_data_t*)arg;
+  bool finished = false;
   /* Loop and handle events */
   do {
     pn_event_batch_t *events = pn_proactor_wait(app->proactor);
     pn_event_t *e;
     for (e = pn_event_batch_next(events); e; e = pn_event_batch_next(events)) {
       if (!handle(app, e)) {
-        return;
+        finished = true;
       }
     }
     pn_proactor_done(app->proactor, events);
-  } while(true);
+  } while(!finished);
+  return NULL;
+}
+
+/* Run the proactor event loop on app->threads threads, including the calling thread */
+void run_threads(app_data_t *app) {
+  pthread_t* threads = (pthread_t*)calloc(app->threads, sizeof(pthread_t));
+  for (int i = 1; i < app->threads; i++) {
+    pthread_create(&threads[i], NULL, run, app);
+  }
+  run(app);
+  for (int i = 1; i < app->threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
 }
 
 void usage(void) {
     printf("Usage: send [options] \n");
     printf("\t-a      The host address [localhost]\n");
     printf("\t-p      The host port [5672]\n");
-    printf("\t-c      # of messages to send [10]\n");
+    printf("\t-c      # of messages to send per connection [10]\n");
     printf("\t-t      Target address [examples]\n");
     printf("\t-i      AMQP Container name [send:<pid>]\n");
     printf("\t-u      Client authentication username []\n");
     printf("\t-P      Client authentication password []\n");
+    printf("\t-e      Send from a pre-encoded message template [false]\n");
+    printf("\t-w      Maximum # of unsettled messages in flight [1024]\n");
+    printf("\t-S      Send messages pre-settled, at-most-once delivery [false]\n");
+    printf("\t-l      Stamp messages with send time and sequence properties for latency, sequences count per connection [false]\n");
+    printf("\t-s      Body size in bytes: <n>, <min>-<max> or @<file> of '<size> [weight]' lines [sequence_<n> text]\n");
+    printf("\t-f      Stream the file as the body of each message, memory mapped []\n");
+    printf("\t-b      Body type for -s: string (amqp-value) or binary (data section) [string]\n");
+    printf("\t-r      Publish rate in messages/sec per connection, 0 for unpaced [0]\n");
+    printf("\t-B      Maximum burst of messages when paced [rate/250]\n");
+    printf("\t-T      # of threads running the proactor [1]\n");
+    printf("\t-C      # of connections [1]\n");
     printf("\t-h      Displays this message\n");
     exit(0);
 
@@ -271,10 +580,21 @@ void parse_args(int argc, char **argv, app_data_t *app){
     app->message_count = 10;
     app->username = NULL;
     app->password = NULL;
+    app->use_template = false;
+    app->max_inflight = 1024;
+    app->presettled = false;
+    app->threads = 1;
+    app->connections = 1;
+    app->stamp = false;
+    app->payload_mode = false;
+    app->binary_body = false;
+    app->rate = 0;
+    app->burst = 0;
+    app->stream_path = NULL;
 
     /* command line options */
     opterr = 0;
-    while((c = getopt(argc, argv, "i:a:c:t:p:P:u:h")) != -1) {
+    while((c = getopt(argc, argv, "i:a:c:t:p:P:u:ew:ST:C:r:B:s:f:b:lh")) != -1) {
         switch(c) {
         case 'h': usage(); break;
         case 'c': 
@@ -294,32 +614,148 @@ void parse_args(int argc, char **argv, app_data_t *app){
         case 'p': app->port = optarg; break;
         case 'P': app->password = optarg; break;
         case 'u': app->username = optarg; break;
+        case 'e': app->use_template = true; break;
+        case 'S': app->presettled = true; break;
+        case 'w':
+            app->max_inflight = atoi(optarg);
+            if (app->max_inflight <= 0) usage();
+            break;
+        case 'l': app->stamp = true; break;
+        case 's':
+            if (payload_parse_size(&app->payload, optarg) != 0) {
+                fprintf(stderr, "Invalid body size: %s\n", optarg);
+                usage();
+            }
+            app->payload_mode = true;
+            break;
+        case 'f': app->stream_path = optarg; break;
+        case 'b':
+            if (strcmp(optarg, "binary") == 0) {
+                app->binary_body = true;
+            } else if (strcmp(optarg, "string") == 0) {
+                app->binary_body = false;
+            } else {
+                usage();
+            }
+            break;
+        case 'r':
+            app->rate = atoi(optarg);
+            if (app->rate < 0) usage();
+            break;
+        case 'B':
+            app->burst = atoi(optarg);
+            if (app->burst < 0) usage();
+            break;
+        case 'T':
+            app->threads = atoi(optarg);
+            if (app->threads <= 0) usage();
+            break;
+        case 'C':
+            app->connections = atoi(optarg);
+            if (app->connections <= 0) usage();
+            break;
         default: usage(); break;
         }
     }
+    if (app->stream_path && app->payload_mode) {
+        fprintf(stderr, "Options -f and -s cannot be combined\n");
+        usage();
+    }
 
 }
 
+/* Initialize connection state, container ids are suffixed with the index when there are several connections */
+static void init_conn_data(app_data_t *app, conn_data_t *conn, int index) {
+    conn->app = app;
+    if (app->connections > 1) {
+        snprintf(conn->container_id, PN_MAX_ADDR, "%s-%d", app->container_id, index);
+    } else {
+        snprintf(conn->container_id, PN_MAX_ADDR, "%s", app->container_id);
+    }
+    if (app->use_template || app->payload_mode || app->stream_path) {
+        init_message_template(conn);
+    }
+    conn->rng = 0x2545f4914f6cdd1dULL * (index + 1);
+    if (inflight_init(&conn->inflight, app->max_inflight) != 0) {
+        fprintf(stderr, "Unable to allocate in-flight window of %d messages\n", app->max_inflight);
+        exit(1);
+    }
+    if (app->rate > 0) {
+        pacer_init(&conn->pacer, app->rate, app->burst);
+    }
+}
+
+static void free_conn_data(conn_data_t *conn) {
+    free(conn->message_buffer.start);
+    msg_template_free(&conn->message_template);
+    inflight_free(&conn->inflight);
+}
+
 int main(int argc, char **argv) {
     struct app_data_t app = {0};
     char addr[PN_MAX_ADDR];
+    int exit_code = 0;
   
     parse_args(argc, argv, &app);
+    if (app.payload_mode && payload_generate(&app.payload, app.binary_body) != 0) {
+        fprintf(stderr, "Unable to allocate message payload of %zu bytes\n", app.payload.max_size);
+        exit(1);
+    }
+    if (app.stream_path) {
+        if (mapped_file_open(&app.stream_file, app.stream_path) != 0) {
+            exit(1);
+        }
+        if (app.stream_file.bytes.size > 0xffffffffu) {
+            /* the data section length is 32 bits */
+            fprintf(stderr, "File too large to send as one message: %s\n", app.stream_path);
+            exit(1);
+        }
+    }
+    conn_data_t *conns = (conn_data_t*)calloc(app.connections, sizeof(conn_data_t));
+    app.conns = conns;
+    pthread_mutex_init(&app.conns_lock, NULL);
     
     app.proactor = pn_proactor();
     pn_proactor_addr(addr, sizeof(addr), app.host, app.port);
-    /* Initial Sasl transport for authentication */
-    pn_transport_t *pnt = pn_transport();
-    pn_sasl_t *sasl = pn_sasl(pnt);
-    pn_sasl_set_allow_insecure_mechs(sasl, true);
+    for (int i = 0; i < app.connections; i++) {
+        init_conn_data(&app, &conns[i], i);
+        pn_connection_t *c = pn_connection();
+        pn_connection_set_context(c, &conns[i]);
+        conns[i].connection = c;
+        /* Initial Sasl transport for authentication */
+        pn_transport_t *pnt = pn_transport();
+        pn_sasl_t *sasl = pn_sasl(pnt);
+        pn_sasl_set_allow_insecure_mechs(sasl, true);
+        pn_proactor_connect2(app.proactor, c, pnt, addr);
+    }
     
-    /* initial and start proton event proactor loop */
-    pn_proactor_connect2(app.proactor, NULL, pnt, addr);
-    run(&app);
+    if (app.rate > 0 || app.stream_path) {
+        /* start the send tick */
+        pn_proactor_set_timeout(app.proactor, SEND_TICK_MS);
+    }
+    /* start proton event proactor loop */
+    run_threads(&app);
 
     /* progam cleanup */
+    histogram_t *ack_latency = (histogram_t*)calloc(1, sizeof(histogram_t));
+    histogram_t *send_lag = (histogram_t*)calloc(1, sizeof(histogram_t));
+    for (int i = 0; i < app.connections; i++) {
+        histogram_merge(ack_latency, &conns[i].ack_latency);
+        histogram_merge(send_lag, &conns[i].send_lag);
+        if (conns[i].exit_code) exit_code = conns[i].exit_code;
+        free_conn_data(&conns[i]);
+    }
+    histogram_print(ack_latency, "ack latency", stdout);
+    if (app.rate > 0) {
+        histogram_print(send_lag, "send lag", stdout);
+    }
+    free(ack_latency);
+    free(send_lag);
+    pthread_mutex_destroy(&app.conns_lock);
+    free(conns);
+    payload_free(&app.payload);
+    mapped_file_close(&app.stream_file);
     pn_proactor_free(app.proactor);
-    free(app.message_buffer.start);
     str_free(app.container_id);
     return exit_code;
 }
@@ -0,0 +1,248 @@
+
+#include "sink.h"
+
+#include <proton/types.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+/* the batch being filled, NULL when every batch is queued, call locked */
+static sink_batch_t *current_batch(sink_t *sink) {
+    if (sink->queued == SINK_QUEUE_BATCHES) {
+        return NULL;
+    }
+    return &sink->batches[(sink->head + sink->queued) % SINK_QUEUE_BATCHES];
+}
+
+/* writev the batches, resuming after partial writes */
+static void write_batches(sink_t *sink, const size_t head, const size_t count) {
+    struct iovec iov[SINK_QUEUE_BATCHES];
+    for (size_t i = 0; i < count; i++) {
+        sink_batch_t *batch = &sink->batches[(head + i) % SINK_QUEUE_BATCHES];
+        iov[i].iov_base = batch->start;
+        iov[i].iov_len = batch->size;
+    }
+    struct iovec *next = iov;
+    int remaining = (int)count;
+    while (remaining > 0) {
+        ssize_t written = writev(sink->fd, next, remaining);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            perror("sink write");
+            sink->write_failed = true;
+            return;
+        }
+        sink->bytes += written;
+        sink->writes++;
+        while (remaining > 0 && (size_t)written >= next->iov_len) {
+            written -= next->iov_len;
+            next++;
+            remaining--;
+        }
+        if (remaining > 0) {
+            next->iov_base = (char*)next->iov_base + written;
+            next->iov_len -= written;
+        }
+    }
+}
+
+static void *writer_run(void *arg) {
+    sink_t *sink = (sink_t*)arg;
+    pthread_mutex_lock(&sink->lock);
+    for (;;) {
+        if (sink->queued == 0 && !sink->closing) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += SINK_FLUSH_MS * 1000000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&sink->ready, &sink->lock, &deadline);
+        }
+        if (sink->queued == 0) {
+            /* no batch filled up in time, write the partial one */
+            if (sink->batches[sink->head].size > 0) {
+                sink->queued = 1;
+            } else if (sink->closing) {
+                break;
+            } else {
+                continue;
+            }
+        }
+        const size_t head = sink->head;
+        const size_t count = sink->queued;
+        /* the queued batches are not touched by writers of records while unlocked */
+        pthread_mutex_unlock(&sink->lock);
+        write_batches(sink, head, count);
+        pthread_mutex_lock(&sink->lock);
+        for (size_t i = 0; i < count; i++) {
+            sink->batches[(head + i) % SINK_QUEUE_BATCHES].size = 0;
+        }
+        sink->head = (head + count) % SINK_QUEUE_BATCHES;
+        sink->queued -= count;
+        pthread_cond_broadcast(&sink->freed);
+    }
+    pthread_mutex_unlock(&sink->lock);
+    return NULL;
+}
+
+int sink_open(sink_t *sink, const char *spec) {
+    memset(sink, 0, sizeof(*sink));
+    sink->fd = -1;
+    if (strcmp(spec, "print") == 0) {
+        sink->kind = SINK_PRINT;
+    } else if (strcmp(spec, "quiet") == 0) {
+        sink->kind = SINK_QUIET;
+    } else if (strcmp(spec, "text") == 0) {
+        sink->kind = SINK_TEXT;
+        sink->fd = STDOUT_FILENO;
+        /* earlier stdio output goes out ahead of the batches */
+        fflush(stdout);
+    } else if (strncmp(spec, "dump:", 5) == 0 && spec[5] != '\0') {
+        sink->kind = SINK_BINARY;
+        sink->blocking = true;
+        sink->fd = open(spec + 5, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (sink->fd < 0) {
+            perror(spec + 5);
+            return -1;
+        }
+    } else {
+        return -1;
+    }
+    pthread_mutex_init(&sink->lock, NULL);
+    if (sink->fd >= 0) {
+        sink->batches = (sink_batch_t*)calloc(SINK_QUEUE_BATCHES, sizeof(sink_batch_t));
+        pthread_cond_init(&sink->ready, NULL);
+        pthread_cond_init(&sink->freed, NULL);
+        pthread_create(&sink->writer, NULL, writer_run, sink);
+    }
+    return 0;
+}
+
+void sink_set_blocking(sink_t *sink, const bool blocking) {
+    pthread_mutex_lock(&sink->lock);
+    sink->blocking = blocking || sink->kind == SINK_BINARY;
+    pthread_mutex_unlock(&sink->lock);
+}
+
+void sink_close(sink_t *sink) {
+    if (sink->batches) {
+        pthread_mutex_lock(&sink->lock);
+        sink->closing = true;
+        pthread_cond_signal(&sink->ready);
+        pthread_mutex_unlock(&sink->lock);
+        pthread_join(sink->writer, NULL);
+        for (size_t i = 0; i < SINK_QUEUE_BATCHES; i++) {
+            free(sink->batches[i].start);
+        }
+        free(sink->batches);
+        sink->batches = NULL;
+        pthread_cond_destroy(&sink->ready);
+        pthread_cond_destroy(&sink->freed);
+        if (sink->kind == SINK_BINARY) {
+            close(sink->fd);
+        }
+    }
+    pthread_mutex_destroy(&sink->lock);
+}
+
+bool sink_wants_text(const sink_t *sink) {
+    return sink->kind == SINK_PRINT || sink->kind == SINK_TEXT;
+}
+
+/* Copies a record into the batch being filled, waiting or dropping it if the queue is full */
+static void sink_write(sink_t *sink, const struct iovec *iov, const int iovcnt) {
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+    }
+    pthread_mutex_lock(&sink->lock);
+    sink->records++;
+    sink_batch_t *batch = current_batch(sink);
+    if (batch && batch->size > 0 && batch->size + len > batch->capacity) {
+        /* queue the filled batch and start the next one */
+        sink->queued++;
+        pthread_cond_signal(&sink->ready);
+        batch = current_batch(sink);
+    }
+    while (!batch && sink->blocking && !sink->closing) {
+        pthread_cond_wait(&sink->freed, &sink->lock);
+        batch = current_batch(sink);
+    }
+    if (batch && batch->capacity < len) {
+        /* batches are allocated on first use, larger records get a larger batch */
+        size_t capacity = len > SINK_BATCH_SIZE ? len : SINK_BATCH_SIZE;
+        char *start = (char*)realloc(batch->start, capacity);
+        if (start) {
+            batch->start = start;
+            batch->capacity = capacity;
+        } else {
+            batch = NULL;
+        }
+    }
+    if (!batch) {
+        if (sink->dropped++ == 0 && sink->blocking) {
+            fprintf(stderr, "Unable to queue a record for the output, records are lost\n");
+        }
+        pthread_mutex_unlock(&sink->lock);
+        return;
+    }
+    for (int i = 0; i < iovcnt; i++) {
+        memcpy(batch->start + batch->size, iov[i].iov_base, iov[i].iov_len);
+        batch->size += iov[i].iov_len;
+    }
+    pthread_mutex_unlock(&sink->lock);
+}
+
+void sink_text(sink_t *sink, const struct iovec *iov, const int iovcnt) {
+    if (sink->kind == SINK_TEXT) {
+        sink_write(sink, iov, iovcnt);
+    } else if (sink->kind == SINK_PRINT) {
+        pthread_mutex_lock(&sink->lock);
+        sink->records++;
+        for (int i = 0; i < iovcnt; i++) {
+            fwrite(iov[i].iov_base, 1, iov[i].iov_len, stdout);
+        }
+        pthread_mutex_unlock(&sink->lock);
+    }
+}
+
+void sink_message(sink_t *sink, const pn_bytes_t message) {
+    if (sink->kind == SINK_BINARY) {
+        unsigned char length[4];
+        length[0] = (unsigned char)(message.size >> 24);
+        length[1] = (unsigned char)(message.size >> 16);
+        length[2] = (unsigned char)(message.size >> 8);
+        length[3] = (unsigned char)message.size;
+        struct iovec iov[2] = {
+            { length, sizeof(length) },
+            { (void*)message.start, message.size }
+        };
+        sink_write(sink, iov, 2);
+    } else {
+        pthread_mutex_lock(&sink->lock);
+        sink->records++;
+        pthread_mutex_unlock(&sink->lock);
+    }
+}
+
+bool sink_failed(const sink_t *sink) {
+    return sink->blocking && (sink->dropped > 0 || sink->write_failed);
+}
+
+void sink_print(sink_t *sink, FILE *out) {
+    if (sink->kind == SINK_PRINT) {
+        return;
+    }
+    fprintf(out, "output: %llu messages, %llu dropped, %llu bytes in %llu writes\n",
+            (unsigned long long)sink->records, (unsigned long long)sink->dropped,
+            (unsigned long long)sink->bytes, (unsigned long long)sink->writes);
+}
@@ -0,0 +1,139 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifndef SINK_H
+#define SINK_H 1
+
+
+#include <proton/types.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+
+
+/*
+ * Where consumers send received messages.
+ * */
+typedef enum sink_kind_t {
+  SINK_PRINT,   /* print each message on the event loop thread */
+  SINK_QUIET,   /* count messages only */
+  SINK_TEXT,    /* print each message, written to stdout in batches by the writer thread */
+  SINK_BINARY   /* dump each encoded message with a 4 byte big endian length prefix */
+} sink_kind_t;
+
+/* Output is gathered in batches of this size */
+#define SINK_BATCH_SIZE (64 * 1024)
+
+/* Batches queued for the writer, records wait or are dropped beyond that */
+#define SINK_QUEUE_BATCHES 64
+
+/* A partially filled batch is written after this long */
+#define SINK_FLUSH_MS 100
+
+typedef struct sink_batch_t {
+  char *start;
+  size_t size;
+  size_t capacity;
+} sink_batch_t;
+
+/*
+ * Output sink for received messages.
+ *
+ * The text and binary sinks copy records into batches on the calling
+ * thread and a writer thread writes the queued batches with writev, so
+ * the event loop never waits on the output. When the writer falls behind
+ * and all batches are queued, new text records are dropped and counted
+ * rather than blocking the consumer. A dump file is a record of every
+ * message, so a binary sink blocks instead: the caller waits until the
+ * writer frees a batch, which holds back the consumer and so its credit.
+ * A sink can be shared by several threads.
+ * */
+typedef struct sink_t {
+  sink_kind_t kind;
+  int fd;
+  pthread_t writer;
+  pthread_mutex_t lock;
+  pthread_cond_t ready;     /* signals the writer that a batch is queued */
+  pthread_cond_t freed;     /* signals blocked callers that batches were written */
+  sink_batch_t *batches;    /* ring of queued batches then the batch being filled */
+  size_t head;              /* oldest queued batch */
+  size_t queued;            /* batches queued for the writer */
+  bool closing;
+  bool blocking;            /* wait for a free batch rather than drop records */
+  bool write_failed;        /* a write to the output failed, records were lost */
+  uint64_t records;         /* messages given to the sink */
+  uint64_t dropped;         /* records dropped while the queue was full */
+  uint64_t bytes;           /* bytes written */
+  uint64_t writes;          /* writev calls */
+} sink_t;
+
+/*
+ * Opens a sink from a specification: 'print', 'quiet', 'text' or
+ * 'dump:<file>', starting the writer thread for text and dump.
+ *
+ * @returns: 0 on success, -1 on an invalid specification or if the
+ *           dump file cannot be created
+ * */
+int sink_open(sink_t *sink, const char *spec);
+
+/*
+ * Makes the text sink wait for a free batch rather than drop records, for
+ * callers without an event loop to keep responsive. Binary sinks always
+ * block.
+ * */
+void sink_set_blocking(sink_t *sink, const bool blocking);
+
+/*
+ * Writes out all queued records, stops the writer and frees the sink.
+ * */
+void sink_close(sink_t *sink);
+
+/*
+ * Returns true if the sink wants messages formatted as text.
+ * */
+bool sink_wants_text(const sink_t *sink);
+
+/*
+ * Outputs one text record made of the given pieces.
+ * */
+void sink_text(sink_t *sink, const struct iovec *iov, const int iovcnt);
+
+/*
+ * Outputs one encoded message: dumped by a binary sink, counted otherwise.
+ * */
+void sink_message(sink_t *sink, const pn_bytes_t message);
+
+/*
+ * Returns true if a blocking sink lost records, ie. it dropped a record
+ * it could not allocate room for or a write failed.
+ * */
+bool sink_failed(const sink_t *sink);
+
+/*
+ * Prints the sink counters.
+ * */
+void sink_print(sink_t *sink, FILE *out);
+
+#endif /* sink.h */
@@ -0,0 +1,231 @@
+
+#include "spool.h"
+
+#include <proton/types.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char SPOOL_MAGIC[8] = { 'a', 'm', 'q', 's', 'p', 'o', 'o', 'l' };
+
+/* Entry sizes marking the end of the ring's used space */
+#define SPOOL_WRAP 0xffffffffu
+
+#define SPOOL_PENDING 1
+#define SPOOL_SENT 2
+#define SPOOL_DONE 3
+
+/* The ring bytes ahead of each message, kept at the entry's position */
+typedef struct spool_entry_t {
+  uint32_t size;         /* message bytes following, SPOOL_WRAP at a wrap marker */
+  uint32_t state;        /* SPOOL_PENDING until handed out, SPOOL_SENT until completed or released */
+  uint64_t sent_ns;      /* when the entry was last handed out */
+} spool_entry_t;
+
+/* Entries start 8 byte aligned */
+static uint64_t entry_span(const uint64_t size) {
+    return SPOOL_ENTRY_HEADER + ((size + 7) & ~(uint64_t)7);
+}
+
+static spool_entry_t *entry_at(const spool_t *spool, const uint64_t position) {
+    return (spool_entry_t*)(spool->ring + position % spool->header->capacity);
+}
+
+/*
+ * Returns the position of the entry at or after position, past a wrap
+ * marker or the end of the ring.
+ * */
+static uint64_t skip_wrap(const spool_t *spool, uint64_t position) {
+    const uint64_t capacity = spool->header->capacity;
+    if (position != spool->header->tail
+        && (capacity - position % capacity < SPOOL_ENTRY_HEADER || entry_at(spool, position)->size == SPOOL_WRAP)) {
+        position += capacity - position % capacity;
+    }
+    return position;
+}
+
+int spool_open(spool_t *spool, const char *path, const size_t capacity) {
+    memset(spool, 0, sizeof(*spool));
+    const uint64_t ring = (capacity + 7) & ~(uint64_t)7;
+    const size_t size = sizeof(spool_header_t) + ring;
+    spool->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (spool->fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(spool->fd, &st) != 0) {
+        perror(path);
+        close(spool->fd);
+        return -1;
+    }
+    const bool created = st.st_size == 0;
+    if (created && ftruncate(spool->fd, size) != 0) {
+        perror(path);
+        close(spool->fd);
+        return -1;
+    }
+    if (!created && (size_t)st.st_size != size) {
+        fprintf(stderr, "Spool %s was created with another size\n", path);
+        close(spool->fd);
+        return -1;
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, spool->fd, 0);
+    if (base == MAP_FAILED) {
+        perror(path);
+        close(spool->fd);
+        return -1;
+    }
+    spool->header = (spool_header_t*)base;
+    spool->ring = (char*)base + sizeof(spool_header_t);
+    if (created) {
+        memcpy(spool->header->magic, SPOOL_MAGIC, sizeof(SPOOL_MAGIC));
+        spool->header->capacity = ring;
+        spool->header->head = 0;
+        spool->header->tail = 0;
+    } else if (memcmp(spool->header->magic, SPOOL_MAGIC, sizeof(SPOOL_MAGIC)) != 0
+               || spool->header->capacity != ring) {
+        fprintf(stderr, "Spool %s is not a spool of %zu bytes\n", path, capacity);
+        spool_close(spool);
+        return -1;
+    }
+    /* whatever was not completed before is sent again */
+    for (uint64_t p = skip_wrap(spool, spool->header->head); p != spool->header->tail;
+         p = skip_wrap(spool, p + entry_span(entry_at(spool, p)->size))) {
+        if (entry_at(spool, p)->state != SPOOL_DONE) {
+            entry_at(spool, p)->state = SPOOL_PENDING;
+            spool->recovered++;
+        }
+    }
+    spool->next = spool->header->head;
+    return 0;
+}
+
+int spool_submit(spool_t *spool, const pn_bytes_t *parts, const int count) {
+    spool_header_t *header = spool->header;
+    uint64_t size = 0;
+    for (int i = 0; i < count; i++) {
+        size += parts[i].size;
+    }
+    const uint64_t span = entry_span(size);
+    uint64_t position = header->tail;
+    uint64_t room = header->capacity - position % header->capacity;
+    /* an entry that does not fit before the end of the ring starts over at the front */
+    const uint64_t padding = room < span ? room : 0;
+    if (size >= SPOOL_WRAP || header->tail - header->head + padding + span > header->capacity) {
+        spool->rejected++;
+        return -1;
+    }
+    if (padding >= SPOOL_ENTRY_HEADER) {
+        entry_at(spool, position)->size = SPOOL_WRAP;
+    }
+    position += padding;
+    spool_entry_t *entry = entry_at(spool, position);
+    char *p = (char*)entry + SPOOL_ENTRY_HEADER;
+    for (int i = 0; i < count; i++) {
+        memcpy(p, parts[i].start, parts[i].size);
+        p += parts[i].size;
+    }
+    entry->size = (uint32_t)size;
+    entry->state = SPOOL_PENDING;
+    entry->sent_ns = 0;
+    /* publish the entry only once it is complete */
+    header->tail = position + span;
+    spool->submitted++;
+    return 0;
+}
+
+bool spool_next(spool_t *spool, const uint64_t now_ns, uint64_t *id, pn_bytes_t *message) {
+    for (uint64_t p = skip_wrap(spool, spool->next); p != spool->header->tail; p = skip_wrap(spool, p)) {
+        spool_entry_t *entry = entry_at(spool, p);
+        p += entry_span(entry->size);
+        if (entry->state != SPOOL_PENDING) {
+            continue;  /* completed, or still in flight when a released entry was handed out again */
+        }
+        entry->state = SPOOL_SENT;
+        entry->sent_ns = now_ns;
+        spool->next = p;
+        spool->sent++;
+        *id = p - entry_span(entry->size);
+        *message = pn_bytes(entry->size, (const char*)entry + SPOOL_ENTRY_HEADER);
+        return true;
+    }
+    spool->next = spool->header->tail;
+    return false;
+}
+
+void spool_complete(spool_t *spool, const uint64_t id, uint64_t *sent_ns) {
+    spool_header_t *header = spool->header;
+    if (id < header->head || id >= header->tail) {
+        return;  /* not an entry of this spool */
+    }
+    spool_entry_t *entry = entry_at(spool, id);
+    if (sent_ns) {
+        *sent_ns = entry->sent_ns;
+    }
+    if (entry->state == SPOOL_DONE) {
+        return;
+    }
+    entry->state = SPOOL_DONE;
+    spool->completed++;
+    /* free the completed run at the head, an entry completed out of order waits for the ones before it */
+    uint64_t head = skip_wrap(spool, header->head);
+    while (head != header->tail && entry_at(spool, head)->state == SPOOL_DONE) {
+        head = skip_wrap(spool, head + entry_span(entry_at(spool, head)->size));
+    }
+    header->head = head;
+    if (spool->next < head) {
+        spool->next = head;
+    }
+}
+
+void spool_release(spool_t *spool, const uint64_t id) {
+    spool_header_t *header = spool->header;
+    if (id < header->head || id >= header->tail || entry_at(spool, id)->state != SPOOL_SENT) {
+        return;  /* not an entry of this spool, or not in flight */
+    }
+    entry_at(spool, id)->state = SPOOL_PENDING;
+    spool->released++;
+    /* the entries after it that are still in flight are skipped, not sent twice */
+    if (spool->next > id) {
+        spool->next = id;
+    }
+}
+
+void spool_rewind(spool_t *spool) {
+    for (uint64_t p = skip_wrap(spool, spool->header->head); p != spool->header->tail;
+         p = skip_wrap(spool, p + entry_span(entry_at(spool, p)->size))) {
+        if (entry_at(spool, p)->state == SPOOL_SENT) {
+            entry_at(spool, p)->state = SPOOL_PENDING;
+        }
+    }
+    spool->next = spool->header->head;
+}
+
+bool spool_empty(const spool_t *spool) {
+    return spool->header->head == spool->header->tail;
+}
+
+void spool_close(spool_t *spool) {
+    if (spool->header) {
+        const size_t size = sizeof(spool_header_t) + spool->header->capacity;
+        msync(spool->header, size, MS_SYNC);
+        munmap(spool->header, size);
+        close(spool->fd);
+        spool->header = NULL;
+        spool->ring = NULL;
+    }
+}
+
+void spool_print(const spool_t *spool, FILE *out) {
+    fprintf(out, "spool: %llu submitted, %llu rejected full, %llu recovered, %llu sent, %llu released, %llu completed, %llu bytes in use\n",
+            (unsigned long long)spool->submitted, (unsigned long long)spool->rejected,
+            (unsigned long long)spool->recovered, (unsigned long long)spool->sent,
+            (unsigned long long)spool->released, (unsigned long long)spool->completed,
+            (unsigned long long)(spool->header ? spool->header->tail - spool->header->head : 0));
+}
@@ -0,0 +1,138 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+
+#ifndef SPOOL_H
+#define SPOOL_H 1
+
+
+#include <proton/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/*
+ * A bounded ring of outgoing messages in a memory mapped file.
+ *
+ * The producer submits encoded messages to the spool without waiting on
+ * the network, a drainer sends them whenever there is credit and completes
+ * each once the peer has accepted it. The file holds a small header with
+ * the ring positions followed by the ring of entries, so messages not yet
+ * completed are sent again when the spool is reopened after a restart.
+ *
+ * Positions are byte offsets that only grow, an entry lives at position
+ * modulo the capacity. Entries are never split over the end of the ring,
+ * a wrap marker sends readers back to the start. The mapping is shared,
+ * so the entries survive the process exiting, they are only msynced when
+ * the spool is closed.
+ *
+ * An entry the peer releases is handed out again on its own, the entries
+ * sent after it that are still in flight are not.
+ * */
+typedef struct spool_header_t {
+  char magic[8];
+  uint64_t capacity;     /* bytes of the ring following the header */
+  uint64_t head;         /* oldest entry not completed */
+  uint64_t tail;         /* where the next entry goes */
+} spool_header_t;
+
+typedef struct spool_t {
+  int fd;
+  spool_header_t *header; /* the mapping, the ring follows the header */
+  char *ring;
+  uint64_t next;          /* next entry to send, not persisted */
+  uint64_t submitted;     /* entries submitted */
+  uint64_t rejected;      /* submits refused because the spool was full */
+  uint64_t sent;          /* entries handed out to send, including resends */
+  uint64_t released;      /* entries handed out again after the peer released them */
+  uint64_t completed;     /* entries completed */
+  uint64_t recovered;     /* entries found not completed when the spool was opened */
+} spool_t;
+
+/* Ring bytes kept ahead of each message */
+#define SPOOL_ENTRY_HEADER 16
+
+/*
+ * Opens the spool file, creating it with room for capacity bytes of
+ * entries if it does not exist. An existing spool keeps its entries and
+ * the ones not completed are sent first.
+ *
+ * @returns: 0 on success, -1 if the file cannot be created or mapped or
+ *           was created with another capacity
+ * */
+int spool_open(spool_t *spool, const char *path, const size_t capacity);
+
+/*
+ * Copies a message made of one or more parts into the spool. Never blocks.
+ *
+ * @returns: 0 on success, -1 if the spool has no room for the message
+ * */
+int spool_submit(spool_t *spool, const pn_bytes_t *parts, const int count);
+
+/*
+ * Hands out the next entry to send and records when it was sent.
+ *
+ * @param[out]: id, identifies the entry to spool_complete
+ * @param[out]: message, the entry bytes, valid until the entry is completed
+ *
+ * @returns: false if every entry has been handed out
+ * */
+bool spool_next(spool_t *spool, const uint64_t now_ns, uint64_t *id, pn_bytes_t *message);
+
+/*
+ * Completes an entry and frees the space of the completed entries at the
+ * head of the ring.
+ *
+ * @param[out]: sent_ns, when the entry was last handed out, may be NULL
+ * */
+void spool_complete(spool_t *spool, const uint64_t id, uint64_t *sent_ns);
+
+/*
+ * Hands out one entry again, for when the peer released or modified it
+ * rather than accepting it. Entries not in flight are left alone.
+ * */
+void spool_release(spool_t *spool, const uint64_t id);
+
+/*
+ * Hands out the entries not completed again, for when they were sent on a
+ * connection that has closed.
+ * */
+void spool_rewind(spool_t *spool);
+
+/*
+ * Returns true if every entry has been completed.
+ * */
+bool spool_empty(const spool_t *spool);
+
+/*
+ * Syncs and unmaps the spool, the entries not completed stay in the file.
+ * */
+void spool_close(spool_t *spool);
+
+/*
+ * Prints the spool counters and the bytes still in use.
+ * */
+void spool_print(const spool_t *spool, FILE *out);
+
+#endif /* spool.h */
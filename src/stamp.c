@@ -0,0 +1,94 @@
+
+#include "stamp.h"
+
+#include <proton/codec.h>
+#include <proton/message.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+int stamp_message(pn_message_t *message, const uint64_t time_ns, const uint64_t sequence) {
+    pn_data_t *properties = pn_message_properties(message);
+    pn_data_put_map(properties);
+    pn_data_enter(properties);
+    pn_data_put_string(properties, pn_bytes(sizeof(STAMP_TIME_PROPERTY) - 1, STAMP_TIME_PROPERTY));
+    pn_data_put_ulong(properties, time_ns);
+    pn_data_put_string(properties, pn_bytes(sizeof(STAMP_SEQUENCE_PROPERTY) - 1, STAMP_SEQUENCE_PROPERTY));
+    pn_data_put_ulong(properties, sequence);
+    pn_data_exit(properties);
+    return pn_data_errno(properties);
+}
+
+/* true if the current string or symbol node equals key */
+static bool key_equals(pn_data_t *data, const char *key, const size_t key_len) {
+    pn_bytes_t bytes;
+    switch (pn_data_type(data)) {
+    case PN_STRING: bytes = pn_data_get_string(data); break;
+    case PN_SYMBOL: bytes = pn_data_get_symbol(data); break;
+    default: return false;
+    }
+    return bytes.size == key_len && memcmp(bytes.start, key, key_len) == 0;
+}
+
+int stamp_read(pn_message_t *message, uint64_t *time_ns, uint64_t *sequence) {
+    pn_data_t *properties = pn_message_properties(message);
+    int found = 0;
+    pn_data_rewind(properties);
+    if (pn_data_next(properties) && pn_data_type(properties) == PN_MAP) {
+        size_t count = pn_data_get_map(properties);
+        pn_data_enter(properties);
+        for (size_t i = 0; i < count / 2; i++) {
+            if (!pn_data_next(properties)) break;
+            bool is_time = key_equals(properties, STAMP_TIME_PROPERTY, sizeof(STAMP_TIME_PROPERTY) - 1);
+            bool is_sequence = !is_time
+                && key_equals(properties, STAMP_SEQUENCE_PROPERTY, sizeof(STAMP_SEQUENCE_PROPERTY) - 1);
+            if (!pn_data_next(properties)) break;
+            if (pn_data_type(properties) != PN_ULONG) continue;
+            if (is_time) {
+                *time_ns = pn_data_get_ulong(properties);
+                found |= 1;
+            } else if (is_sequence) {
+                *sequence = pn_data_get_ulong(properties);
+                found |= 2;
+            }
+        }
+    }
+    pn_data_rewind(properties);
+    return found == 3 ? 1 : 0;
+}
+
+int stamp_read_view(const msg_view_t *view, uint64_t *time_ns, uint64_t *sequence) {
+    pn_bytes_t time_value, sequence_value;
+    return msg_view_map_get(view->application_properties, STAMP_TIME_PROPERTY,
+                            sizeof(STAMP_TIME_PROPERTY) - 1, &time_value) == 0
+        && msg_view_map_get(view->application_properties, STAMP_SEQUENCE_PROPERTY,
+                            sizeof(STAMP_SEQUENCE_PROPERTY) - 1, &sequence_value) == 0
+        && msg_view_get_ulong(time_value, time_ns) == 0
+        && msg_view_get_ulong(sequence_value, sequence) == 0 ? 1 : 0;
+}
+
+void stamp_record(stamp_stats_t *stats, const uint64_t time_ns, const uint64_t sequence, const uint64_t now_ns) {
+    /* clocks of separate processes can disagree slightly, clamp at 0 */
+    histogram_record(&stats->latency, now_ns > time_ns ? now_ns - time_ns : 0);
+    if (!stats->unordered && stats->latency.total > 1 && sequence != stats->last_sequence + 1) {
+        stats->gaps++;
+    }
+    stats->last_sequence = sequence;
+}
+
+void stamp_merge(stamp_stats_t *dest, const stamp_stats_t *src) {
+    histogram_merge(&dest->latency, &src->latency);
+    dest->gaps += src->gaps;
+    dest->unordered = dest->unordered || src->unordered;
+}
+
+void stamp_print(const stamp_stats_t *stats, const char *name, FILE *out) {
+    if (stats->latency.total == 0) {
+        return;
+    }
+    histogram_print(&stats->latency, name, out);
+    if (!stats->unordered) {
+        fprintf(out, "%s: sequence gaps=%llu\n", name, (unsigned long long)stats->gaps);
+    }
+}
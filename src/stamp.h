@@ -0,0 +1,115 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifndef STAMP_H
+#define STAMP_H 1
+
+
+#include <proton/message.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "histogram.h"
+#include "msg_view.h"
+
+
+/*
+ * End to end latency stamps are carried as two ulong application
+ * properties: the sender CLOCK_REALTIME time in nanoseconds and the
+ * sender sequence number.
+ *
+ * Sequence numbers restart at each sender connection, so gaps only mean
+ * lost or reordered messages when one statistics record sees the whole
+ * stream of one sender connection in order. A sender with several
+ * connections interleaves their sequences, and receive workers and lanes
+ * each see only part of the stream.
+ * */
+#define STAMP_TIME_PROPERTY "send_time_ns"
+
+#define STAMP_SEQUENCE_PROPERTY "send_sequence"
+
+/*
+ * Placeholder values for pre-encoded templates. They are large enough to
+ * be encoded as 8 byte ulongs and distinct enough to be found in the
+ * encoded bytes, see msg_template_find_ulong.
+ * */
+#define STAMP_TIME_PLACEHOLDER 0x5354414d5054494dULL
+
+#define STAMP_SEQUENCE_PLACEHOLDER 0x5354414d50534551ULL
+
+/*
+ * Adds the stamp application properties to a message.
+ *
+ * @returns: 0 on success or a negative proton error code
+ * */
+int stamp_message(pn_message_t *message, const uint64_t time_ns, const uint64_t sequence);
+
+/*
+ * Reads the stamp application properties from a decoded message.
+ * parameter out:
+ *      time_ns: the sender time in nanoseconds
+ *      sequence: the sender sequence number
+ * returns:
+ *      1 if both stamps were found, 0 otherwise
+ * */
+int stamp_read(pn_message_t *message, uint64_t *time_ns, uint64_t *sequence);
+
+/*
+ * Reads the stamp application properties in place from a message view,
+ * same results as stamp_read without decoding the message.
+ * */
+int stamp_read_view(const msg_view_t *view, uint64_t *time_ns, uint64_t *sequence);
+
+/*
+ * Receiver side end to end latency statistics. Zero initialize before use.
+ * */
+typedef struct stamp_stats_t {
+  histogram_t latency;     /* receive minus send time in nanoseconds */
+  uint64_t last_sequence;
+  uint64_t gaps;           /* sequence numbers that did not follow the previous one */
+  bool unordered;          /* sees part of a stream or several streams, gaps are not counted */
+} stamp_stats_t;
+
+/*
+ * Records the latency of one stamped message.
+ *
+ * @param[in,out]: stats, the statistics to update
+ * @param[in]: time_ns, the stamped send time
+ * @param[in]: sequence, the stamped sequence number
+ * @param[in]: now_ns, the CLOCK_REALTIME receive time
+ * */
+void stamp_record(stamp_stats_t *stats, const uint64_t time_ns, const uint64_t sequence, const uint64_t now_ns);
+
+/*
+ * Adds the statistics in src to dest, the gaps are not counted if
+ * either is unordered.
+ * */
+void stamp_merge(stamp_stats_t *dest, const stamp_stats_t *src);
+
+/*
+ * Prints the latency percentiles and sequence gaps when they are counted,
+ * nothing if no stamped message was recorded.
+ * */
+void stamp_print(const stamp_stats_t *stats, const char *name, FILE *out);
+
+#endif /* stamp.h */
@@ -0,0 +1,98 @@
+
+#include "subscription.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SUBSCRIPTION_LINE_MAX 1024
+
+int subscription_list_add(subscription_list_t *list, const char *name, const char *topic) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 16;
+        subscription_t *items = (subscription_t*)realloc(list->items, capacity * sizeof(subscription_t));
+        if (!items) {
+            return -1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    subscription_t *sub = &list->items[list->count];
+    memset(sub, 0, sizeof(*sub));
+    sub->name = strdup(name);
+    sub->topic = strdup(topic);
+    if (!sub->name || !sub->topic) {
+        free(sub->name);
+        free(sub->topic);
+        return -1;
+    }
+    list->count++;
+    return 0;
+}
+
+int subscription_list_load(subscription_list_t *list, const char *path) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        return -1;
+    }
+    char line[SUBSCRIPTION_LINE_MAX];
+    int number = 0;
+    int status = 0;
+    while (status == 0 && fgets(line, sizeof(line), in)) {
+        number++;
+        char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+        char *name = strtok(p, " \t\r\n");
+        char *topic = strtok(NULL, " \t\r\n");
+        if (!topic || strtok(NULL, " \t\r\n")) {
+            status = number;  /* expected exactly a name and a topic */
+        } else if (subscription_list_add(list, name, topic) != 0) {
+            status = -1;
+        }
+    }
+    if (status == 0 && ferror(in)) {
+        status = -1;
+    }
+    fclose(in);
+    return status;
+}
+
+void subscription_list_credit(subscription_list_t *list, const int max_window, const size_t byte_budget,
+                              const int latency_ms) {
+    if (list->count == 0) {
+        return;
+    }
+    /* every subscription keeps enough credit to make progress */
+    int window = max_window / list->count;
+    if (window < CREDIT_MIN_WINDOW) {
+        window = CREDIT_MIN_WINDOW;
+    }
+    size_t bytes = byte_budget / list->count;
+    if (bytes == 0) {
+        bytes = 1;
+    }
+    for (int i = 0; i < list->count; i++) {
+        credit_init(&list->items[i].credit, window, bytes, latency_ms);
+    }
+}
+
+void subscription_list_free(subscription_list_t *list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->items[i].name);
+        free(list->items[i].topic);
+    }
+    free(list->items);
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+void subscription_print(const subscription_t *sub, FILE *out) {
+    fprintf(out, "subscription %s: topic=%s received=%llu bytes=%llu\n", sub->name, sub->topic,
+            (unsigned long long)sub->received, (unsigned long long)sub->bytes);
+    credit_print(&sub->credit, sub->name, out);
+}
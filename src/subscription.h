@@ -0,0 +1,86 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+
+#ifndef SUBSCRIPTION_H
+#define SUBSCRIPTION_H 1
+
+
+#include <proton/link.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "credit.h"
+
+
+/*
+ * A durable subscription attached as a receiver link. The link name is
+ * the subscription name and the link source address is its topic.
+ * */
+typedef struct subscription_t {
+  char *name;
+  char *topic;
+  pn_link_t *link;       /* NULL until attached */
+  credit_t credit;       /* adaptive credit within the subscription's share */
+  uint64_t received;     /* messages accepted */
+  uint64_t bytes;        /* bytes of the messages accepted */
+} subscription_t;
+
+typedef struct subscription_list_t {
+  subscription_t *items;
+  int count;
+  int capacity;
+} subscription_list_t;
+
+/*
+ * Appends a subscription, copying the name and topic.
+ *
+ * @returns: 0 on success, -1 if allocation failed
+ * */
+int subscription_list_add(subscription_list_t *list, const char *name, const char *topic);
+
+/*
+ * Appends the subscriptions of a list file. Each line holds a subscription
+ * name and its topic separated by white space, blank lines and lines
+ * starting with '#' are skipped.
+ *
+ * @returns: 0 on success, -1 if the file could not be read or allocation
+ *           failed, else the number of the first malformed line
+ * */
+int subscription_list_load(subscription_list_t *list, const char *path);
+
+/*
+ * Splits a credit window and byte budget evenly over the subscriptions, so
+ * a busy subscription cannot take the credit of the others.
+ * */
+void subscription_list_credit(subscription_list_t *list, const int max_window, const size_t byte_budget,
+                              const int latency_ms);
+
+void subscription_list_free(subscription_list_t *list);
+
+/*
+ * Prints the subscription's counters and credit.
+ * */
+void subscription_print(const subscription_t *sub, FILE *out);
+
+#endif /* subscription.h */
@@ -0,0 +1,116 @@
+
+#include "topic.h"
+
+#include <proton/proactor.h>
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* room for a name of PN_MAX_ADDR with blanks and a comment around it */
+#define TOPIC_LINE_MAX (2 * PN_MAX_ADDR)
+
+int topic_list_add(topic_list_t *list, const char *name) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 16;
+        topic_t *items = (topic_t*)realloc(list->items, capacity * sizeof(topic_t));
+        if (!items) {
+            return -1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    topic_t *topic = &list->items[list->count];
+    memset(topic, 0, sizeof(*topic));
+    topic->name = strdup(name);
+    if (!topic->name) {
+        return -1;
+    }
+    topic->name_len = strlen(name);
+    list->count++;
+    return 0;
+}
+
+int topic_list_load(topic_list_t *list, const char *path) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        return -1;
+    }
+    char line[TOPIC_LINE_MAX];
+    int number = 0;
+    int status = 0;
+    while (status == 0 && fgets(line, sizeof(line), in)) {
+        number++;
+        if (!strchr(line, '\n') && !feof(in)) {
+            status = number;  /* longer than the line buffer, the rest would read as another topic */
+            break;
+        }
+        char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+        char *name = strtok(p, " \t\r\n");
+        if (strtok(NULL, " \t\r\n") || strlen(name) >= PN_MAX_ADDR) {
+            status = number;  /* expected a single topic that fits an address */
+        } else if (topic_list_add(list, name) != 0) {
+            status = -1;
+        }
+    }
+    if (status == 0 && ferror(in)) {
+        status = -1;
+    }
+    fclose(in);
+    return status;
+}
+
+int topic_list_generate(topic_list_t *list, const char *pattern, const int count) {
+    const char *index = strstr(pattern, "%d");
+    const size_t head = index ? (size_t)(index - pattern) : strlen(pattern);
+    const char *tail = index ? index + 2 : "";
+    char *name = (char*)malloc(strlen(pattern) + 16);
+    if (!name) {
+        return -1;
+    }
+    int status = 0;
+    for (int i = 0; status == 0 && i < count; i++) {
+        /* the pattern is not a format string, only the index is formatted */
+        memcpy(name, pattern, head);
+        sprintf(name + head, index ? "%d%s" : "/%d%s", i, tail);
+        status = topic_list_add(list, name);
+    }
+    free(name);
+    return status;
+}
+
+void topic_list_free(topic_list_t *list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->items[i].name);
+    }
+    free(list->items);
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+void topic_list_print(const topic_list_t *list, const uint64_t elapsed_ns, FILE *out) {
+    const double seconds = elapsed_ns > 0 ? elapsed_ns / 1e9 : 1.0;
+    uint64_t sent = 0, bytes = 0, min = UINT64_MAX, max = 0;
+    for (int i = 0; i < list->count; i++) {
+        const topic_t *topic = &list->items[i];
+        fprintf(out, "topic %s: sent=%llu bytes=%llu %.1f msg/s %.3f MB/s\n", topic->name,
+                (unsigned long long)topic->sent, (unsigned long long)topic->bytes,
+                topic->sent / seconds, topic->bytes / seconds / 1e6);
+        sent += topic->sent;
+        bytes += topic->bytes;
+        if (topic->sent < min) min = topic->sent;
+        if (topic->sent > max) max = topic->sent;
+    }
+    if (list->count > 0) {
+        fprintf(out, "topics: %d topics sent=%llu bytes=%llu %.1f msg/s %.3f MB/s, per topic %.1f to %.1f msg/s\n",
+                list->count, (unsigned long long)sent, (unsigned long long)bytes,
+                sent / seconds, bytes / seconds / 1e6, min / seconds, max / seconds);
+    }
+}
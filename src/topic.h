@@ -0,0 +1,84 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+
+#ifndef TOPIC_H
+#define TOPIC_H 1
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/*
+ * A topic messages are published to. The name is the base address, the
+ * topic prefix is added when the message is addressed.
+ * */
+typedef struct topic_t {
+  char *name;
+  size_t name_len;
+  uint64_t sent;         /* messages sent, resends are not counted again */
+  uint64_t bytes;        /* bytes of the messages sent */
+} topic_t;
+
+typedef struct topic_list_t {
+  topic_t *items;
+  int count;
+  int capacity;
+} topic_list_t;
+
+/*
+ * Appends a topic, copying the name.
+ *
+ * @returns: 0 on success, -1 if allocation failed
+ * */
+int topic_list_add(topic_list_t *list, const char *name);
+
+/*
+ * Appends the topics of a file, one per line. Blank lines and lines
+ * starting with '#' are skipped. A line with more than one name or a name
+ * of PN_MAX_ADDR bytes or more is malformed.
+ *
+ * @returns: 0 on success, -1 if the file could not be read or allocation
+ *           failed, else the number of the first malformed line
+ * */
+int topic_list_load(topic_list_t *list, const char *path);
+
+/*
+ * Appends 'count' topics named from a pattern, the first '%d' of the
+ * pattern is replaced by the topic index from 0. Without a '%d' the
+ * index is appended as '/<index>'.
+ *
+ * @returns: 0 on success, -1 if allocation failed
+ * */
+int topic_list_generate(topic_list_t *list, const char *pattern, const int count);
+
+void topic_list_free(topic_list_t *list);
+
+/*
+ * Prints each topic's counters and rates, then the totals.
+ *
+ * @param[in]: elapsed_ns, the time the messages were sent over
+ * */
+void topic_list_print(const topic_list_t *list, const uint64_t elapsed_ns, FILE *out);
+
+#endif /* topic.h */
@@ -5,89 +5,15 @@
 #include <proton/types.h>
 #include <proton/object.h>
 
+#include <ctype.h>
+#include <errno.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <libgen.h>
-
-/* 
- * Walks through a pn_data_t of type PN_MAP checking 
- * key value pairs for a match to the given search 'key'.
- * The given pn_data_t is restored to its initial starting
- * point. TODO improve linear search.
- * */
-int get_data_map_string_property( pn_data_t* properties, 
-                                    const char* const key, 
-                                    char* value, const size_t value_size) {
-      int found = -2; /* default return code for in valid arguments */
-      if (properties && key && value && value_size > 0) {
-        pn_handle_t data_start = pn_data_point(properties);
-        if(pn_data_type(properties) == PN_MAP) {
-            const size_t key_len = strlen(key);
-            const char *map_value = NULL;
-            size_t count = pn_data_get_map(properties);
-            pn_data_enter(properties);
-            for (int i=0; i<count/2; i++) {
-                found = -1; /* return code for not found search key */
-                if(pn_data_next(properties)) {
-                    /* parse map key */
-                    switch(pn_data_type(properties)) {
-                    case PN_STRING: {
-                        pn_bytes_t key_bytes = pn_data_get_string(properties);
-                        map_value = key_bytes.start;
-                        printf("string Key:%s\n", map_value);
-                        found = key_bytes.size < key_len ? -1 : 0;
-                        break;
-                    }
-                    case PN_SYMBOL: {
-                        pn_bytes_t key_bytes = pn_data_get_symbol(properties);
-                        map_value = key_bytes.start;
-                        printf("symbol Key:%s\n", map_value);
-                        found = key_bytes.size < key_len ? -1 : 0;
-                        break;
-                    }
-                    default: printf("Ignoring data key field type: %s\n", pn_type_name(pn_data_type(properties))); break;
-                    }
-                    if(found == 0 && strncmp(key, map_value, key_len)==0) {
-                        /* found matching key */
-                        found=1;
-                    }
-                }
-                if (pn_data_next(properties) && found == 1) {
-                    map_value = NULL;
-                    /* parse map value */
-                    switch (pn_data_type(properties)) {
-                    case PN_STRING: {
-                        pn_bytes_t value_bytes = pn_data_get_string(properties);
-                        map_value = value_bytes.start;
-                        printf("string Value:%s\n", map_value);
-                        break;
-                    }
-                    case PN_SYMBOL: {
-                        pn_bytes_t value_bytes = pn_data_get_string(properties);
-                        map_value = value_bytes.start;
-                        printf("Symbol Value:%s\n", map_value);
-                        break;
-                    }
-                    default: printf("Ignoring data value field type: %s\n", pn_type_name(pn_data_type(properties))); break;
-                    }
-                    /* assign prefix if present */
-                    if (map_value) {
-                        found = sprintf(value, "%s", map_value) > 0 ? 1 : 0;
-                        break; /* for loop */
-                    }
-
-                }
-            } /* end for loop */
-        } else {
-            fprintf(stderr, "Unexpected type: %s, for properties", pn_type_name(pn_data_type(properties)));
-        }
-        pn_data_restore(properties, data_start);
-    }
-    return found; 
-}
+#include <time.h>
 
 /* 
  * Formats an amqp address to given 'dest' pointer with given 'address_prefix'.
@@ -142,4 +68,37 @@ int container_id(char *dest, const size_t dest_len, char *source, const size_t s
     }
 }
 
+uint64_t monotonic_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
 
+uint64_t realtime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t hash_bytes(const char *bytes, const size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ (unsigned char)bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+int parse_size(const char *s, size_t *value) {
+    /* strtoull would skip blanks and negate a leading minus */
+    if (!isdigit((unsigned char)s[0])) {
+        return -1;
+    }
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(s, &end, 10);
+    if (errno != 0 || *end != '\0' || v > SIZE_MAX) {
+        return -1;
+    }
+    *value = (size_t)v;
+    return 0;
+}
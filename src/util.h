@@ -25,25 +25,10 @@
 
 #include <proton/codec.h>
 
+#include <stdint.h>
 #include <stdlib.h>
 
 
-/*
- * get string/symbol value from pn_data_t type map
- * parameters in:
- *      properties: the pointer to pn_data_t, this must be a map.
- *      key: the search key string for the target value. 
- * parameter out:
- *      value: string value of map value at key. Is set to NULL on miss.
- * returns:
- *      Integer code indicating hit or miss in search.
- *      -2, properties was not of type PN_MAP or invalid parameter
- *      -1, search key of type PN_STRING or PN_SYMBOL was not found in map
- *      0, a key was found matching the search key but the target value type was not PN_STRING or PN_SYMBOL
- *      1, a key was found matching the search key and the value was assigned
- * */
-int get_data_map_string_property(pn_data_t* properties, const char* const key, char* value, const size_t value_size);
-
 /*
  * Formats an AMQP terminus address with a destination type prefix.
  * The address_prefix is only added if the base address does not start
@@ -78,4 +63,31 @@ int amqp_destination_address(char* dest, const size_t dest_len,
 int container_id(char *dest, const size_t dest_len, 
                 char *source, const size_t source_len);
 
+/*
+ * Reads the monotonic clock.
+ *
+ * @returns: the CLOCK_MONOTONIC time in nanoseconds
+ * */
+uint64_t monotonic_time_ns(void);
+
+/*
+ * Reads the wall clock, comparable between processes.
+ *
+ * @returns: the CLOCK_REALTIME time in nanoseconds
+ * */
+uint64_t realtime_ns(void);
+
+/*
+ * FNV-1a hash of a byte string, for hash tables and key lanes.
+ * */
+uint64_t hash_bytes(const char *bytes, const size_t size);
+
+/*
+ * Parses a whole non-negative decimal number, eg. an option argument.
+ *
+ * @returns: 0 on success, -1 if the string is empty, not a number, has
+ *           trailing characters or is out of range
+ * */
+int parse_size(const char *s, size_t *value);
+
 #endif /* util.h */
@@ -0,0 +1,84 @@
+
+#include "workq.h"
+
+#include <errno.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+int workq_init(workq_t *q, const size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size *= 2;
+    }
+    q->cells = (workq_cell_t*)calloc(size, sizeof(workq_cell_t));
+    if (!q->cells) {
+        return -1;
+    }
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&q->cells[i].sequence, i);
+    }
+    q->mask = size - 1;
+    atomic_init(&q->enqueue_pos, 0);
+    atomic_init(&q->dequeue_pos, 0);
+    sem_init(&q->available, 0, 0);
+    return 0;
+}
+
+void workq_free(workq_t *q) {
+    sem_destroy(&q->available);
+    free(q->cells);
+    q->cells = NULL;
+}
+
+bool workq_push(workq_t *q, void *item) {
+    size_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    workq_cell_t *cell;
+    for (;;) {
+        cell = &q->cells[pos & q->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        long diff = (long)sequence - (long)pos;
+        if (diff == 0) {
+            /* the cell is free for this position, claim the position */
+            if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* the cell still holds the item from one lap ago */
+            return false;
+        } else {
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    cell->item = item;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    sem_post(&q->available);
+    return true;
+}
+
+void *workq_pop_wait(workq_t *q) {
+    while (sem_wait(&q->available) != 0 && errno == EINTR) {
+    }
+    /* the semaphore guarantees an item is published or about to be */
+    size_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    workq_cell_t *cell;
+    for (;;) {
+        cell = &q->cells[pos & q->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        long diff = (long)sequence - (long)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else {
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    void *item = cell->item;
+    /* free the cell for the enqueue one lap ahead */
+    atomic_store_explicit(&cell->sequence, pos + q->mask + 1, memory_order_release);
+    return item;
+}
@@ -0,0 +1,76 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifndef WORKQ_H
+#define WORKQ_H 1
+
+
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+
+typedef struct workq_cell_t {
+  atomic_size_t sequence;
+  void *item;
+} workq_cell_t;
+
+/*
+ * Bounded lock-free multi-producer multi-consumer queue of pointers.
+ *
+ * Each cell carries a sequence number telling producers and consumers
+ * whether it is free for the enqueue or holds an item for the dequeue at
+ * a given position, so positions are claimed with a single compare and
+ * swap and no lock is taken. A semaphore counting the queued items lets
+ * idle consumers sleep in workq_pop_wait.
+ * */
+typedef struct workq_t {
+  workq_cell_t *cells;
+  size_t mask;                  /* capacity - 1, the capacity is a power of two */
+  atomic_size_t enqueue_pos;
+  char pad[64];                 /* keep producer and consumer positions on separate cache lines */
+  atomic_size_t dequeue_pos;
+  sem_t available;
+} workq_t;
+
+/*
+ * Allocates a queue for at least 'capacity' items.
+ *
+ * @returns: 0 on success, -1 if allocation failed
+ * */
+int workq_init(workq_t *q, const size_t capacity);
+
+void workq_free(workq_t *q);
+
+/*
+ * Adds an item, NULL items are allowed and can be used to stop consumers.
+ *
+ * @returns: true on success, false if the queue is full
+ * */
+bool workq_push(workq_t *q, void *item);
+
+/*
+ * Removes the oldest item, waiting for one if the queue is empty.
+ * */
+void *workq_pop_wait(workq_t *q);
+
+#endif /* workq.h */